@@ -0,0 +1,68 @@
+#include <cstdlib>
+#include <iostream>
+#include <opencv2/core.hpp>
+#include <mpi.h>
+#include <string>
+
+#include "filter_engine/batch.hpp"
+
+using namespace std;
+
+int main(int argc, char** argv) {
+    // Threads filter whole images or strips, only the main thread calls MPI
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    // Kernel size, images and output directory come first, the execution
+    // options after them
+    int positional = 1;
+    while (positional < argc && positional <= 3 && string(argv[positional]).compare(0, 2, "--") != 0) {
+        ++positional;
+    }
+    if (positional < 3) {
+        if (rank == 0) {
+            cerr << "Usage: " << argv[0] << " <kernel size> <image directory or manifest> [output directory] [options]" << endl;
+        }
+        MPI_Finalize();
+        return -1;
+    }
+    hpf::BatchOptions options;
+    if (positional > 3) {
+        options.outputDir = argv[3];
+    }
+
+    hpf::ExecutionPolicy policy;
+    policy.backend = provided >= MPI_THREAD_FUNNELED ? hpf::Backend::Hybrid : hpf::Backend::MPI;
+    policy.tiled = true;
+    if (!hpf::parseBatchArgs(argc - positional + 1, argv + positional - 1, policy, options)) {
+        MPI_Finalize();
+        return -1;
+    }
+
+    // The kernel is generated and broadcast once for the whole batch
+    hpf::Kernel kernel;
+    vector<string> paths;
+    if (rank == 0) {
+        kernel = hpf::generateHighPassKernel(atoi(argv[1]));
+        paths = hpf::listImages(argv[2]);
+        cout << "Images: " << paths.size() << endl;
+    }
+    hpf::broadcastKernel(kernel, 0, MPI_COMM_WORLD);
+    if (kernel.empty()) {
+        MPI_Finalize();
+        return -1;
+    }
+
+    hpf::BatchStats stats = hpf::filterBatch(paths, kernel, policy, options);
+    if (rank == 0) {
+        cout << hpf::describeBatch(stats);
+    }
+    if (!policy.tracePath.empty()) {
+        hpf::writeTrace(policy.tracePath, MPI_COMM_WORLD);
+    }
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,333 @@
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mpi.h>
+#include <omp.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "filter_engine/filter_engine.hpp"
+
+using namespace std;
+
+// What is measured and how often
+struct Settings {
+    vector<double> megapixels{ 1, 16, 100 };
+    vector<int> kernels{ 3, 7, 15, 31, 63 };
+    vector<hpf::Backend> backends{ hpf::Backend::Sequential, hpf::Backend::OpenMP, hpf::Backend::MPI,
+        hpf::Backend::Hybrid };
+    vector<int> workers;  // Thread counts for OpenMP, rank counts for MPI and Hybrid; empty for powers of two
+    bool weak = false;    // Grow the image with the workers instead of keeping it fixed
+    bool highPass = false;
+    int warmup = 1;
+    int repeats = 5;
+    string csvPath;
+    string jsonPath;
+    string outputMode = "saturate";
+};
+
+// One measured configuration
+struct Row {
+    string backend;
+    string strategy;
+    cv::Size size;
+    int kernel;
+    int ranks;
+    int threads;
+    double medianMs;
+    double p95Ms;
+    double efficiency;
+};
+
+// Comma separated list of numbers; false if any is invalid
+template <class T>
+static bool parseList(const string& text, vector<T>& values) {
+    values.clear();
+    stringstream items(text);
+    string item;
+    while (getline(items, item, ',')) {
+        char* end = nullptr;
+        double value = strtod(item.c_str(), &end);
+        if (end == item.c_str() || *end != '\0' || value <= 0) {
+            return false;
+        }
+        values.push_back(T(value));
+    }
+    return !values.empty();
+}
+
+static bool parseBackends(const string& text, vector<hpf::Backend>& backends) {
+    backends.clear();
+    stringstream items(text);
+    string item;
+    while (getline(items, item, ',')) {
+        hpf::ExecutionPolicy parsed;
+        if (!hpf::parseBackend(item, parsed)) {
+            return false;
+        }
+        backends.push_back(parsed.backend);
+    }
+    return !backends.empty();
+}
+
+// Split the benchmark options off and hand the rest to parseExecutionArgs()
+static bool parseArgs(int argc, char** argv, Settings& settings, hpf::ExecutionPolicy& policy) {
+    vector<char*> rest{ argv[0] };
+    for (int i = 1; i < argc; ++i) {
+        string option = argv[i];
+        if (option == "--weak" || option == "--high-pass") {
+            (option == "--weak" ? settings.weak : settings.highPass) = true;
+            continue;
+        }
+        bool known = option == "--megapixels" || option == "--kernels" || option == "--backends" ||
+            option == "--workers" || option == "--warmup" || option == "--repeats" || option == "--csv" ||
+            option == "--json" || option == "--output";
+        if (!known) {
+            rest.push_back(argv[i]);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            cerr << "Error: Missing value for " << option << "." << endl;
+            return false;
+        }
+        string value = argv[++i];
+        bool valid = true;
+        if (option == "--megapixels") {
+            valid = parseList(value, settings.megapixels);
+        }
+        else if (option == "--kernels") {
+            valid = parseList(value, settings.kernels);
+        }
+        else if (option == "--backends") {
+            valid = parseBackends(value, settings.backends);
+        }
+        else if (option == "--workers") {
+            valid = parseList(value, settings.workers);
+        }
+        else if (option == "--warmup" || option == "--repeats") {
+            int count = atoi(value.c_str());
+            valid = count >= 0 && (option == "--warmup" || count > 0);
+            (option == "--warmup" ? settings.warmup : settings.repeats) = count;
+        }
+        else if (option == "--output") {
+            hpf::FilterPlan plan;
+            valid = hpf::parseOutputMode(value, plan);
+            settings.outputMode = value;
+        }
+        else {
+            (option == "--csv" ? settings.csvPath : settings.jsonPath) = value;
+        }
+        if (!valid) {
+            cerr << "Error: Invalid value " << value << " for " << option << "." << endl;
+            return false;
+        }
+    }
+    return hpf::parseExecutionArgs(int(rest.size()), rest.data(), policy);
+}
+
+// Powers of two up to limit, and limit itself
+static vector<int> powersOfTwo(int limit) {
+    vector<int> counts;
+    for (int n = 1; n < limit; n *= 2) {
+        counts.push_back(n);
+    }
+    counts.push_back(limit);
+    return counts;
+}
+
+// Nearest-rank percentile of sorted times
+static double percentile(const vector<double>& sorted, double p) {
+    size_t index = size_t(ceil(p * sorted.size()));
+    return sorted[min(max(index, size_t(1)), sorted.size()) - 1];
+}
+
+// Square-ish image of about megapixels million pixels
+static cv::Size imageSize(double megapixels) {
+    int side = max(int(sqrt(megapixels * 1e6)), 1);
+    return cv::Size(side, max(int(megapixels * 1e6 / side), 1));
+}
+
+// Wall time of every repetition on the ranks of comm, the slowest rank's
+// time counting; filled on rank 0 of comm only
+static vector<double> measure(const cv::Mat& image, const hpf::FilterPlan& plan, const hpf::ExecutionPolicy& policy,
+    MPI_Comm comm, const Settings& settings) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    vector<double> times;
+    for (int r = 0; r < settings.warmup + settings.repeats; ++r) {
+        MPI_Barrier(comm);
+        double start = MPI_Wtime();
+        cv::Mat output = hpf::convolve(image, plan, policy);
+        double elapsed = MPI_Wtime() - start;
+        double slowest = elapsed;
+        MPI_Reduce(&elapsed, &slowest, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+        if (rank == 0 && r >= settings.warmup) {
+            times.push_back(slowest * 1000);
+        }
+    }
+    sort(times.begin(), times.end());
+    return times;
+}
+
+static void writeCsv(ostream& out, const vector<Row>& rows, bool weak) {
+    out << "backend,strategy,scaling,width,height,megapixels,kernel,ranks,threads,cores,median_ms,p95_ms,"
+        "mpixels_per_s,efficiency" << endl;
+    for (const Row& row : rows) {
+        double megapixels = double(row.size.area()) / 1e6;
+        out << row.backend << "," << row.strategy << "," << (weak ? "weak" : "strong") << "," << row.size.width
+            << "," << row.size.height << "," << megapixels << "," << row.kernel << "," << row.ranks << ","
+            << row.threads << "," << row.ranks * row.threads << "," << row.medianMs << "," << row.p95Ms << ","
+            << megapixels / (row.medianMs / 1000) << "," << row.efficiency << endl;
+    }
+}
+
+static void writeJson(ostream& out, const vector<Row>& rows, bool weak) {
+    out << "{\n  \"scaling\": \"" << (weak ? "weak" : "strong") << "\",\n  \"simd\": \""
+        << hpf::simdLevelName(hpf::detectSimdLevel()) << "\",\n  \"results\": [";
+    for (size_t i = 0; i < rows.size(); ++i) {
+        const Row& row = rows[i];
+        double megapixels = double(row.size.area()) / 1e6;
+        out << (i ? "," : "") << "\n    { \"backend\": \"" << row.backend << "\", \"strategy\": \"" << row.strategy
+            << "\", \"width\": " << row.size.width << ", \"height\": " << row.size.height << ", \"kernel\": "
+            << row.kernel << ", \"ranks\": " << row.ranks << ", \"threads\": " << row.threads
+            << ", \"median_ms\": " << row.medianMs << ", \"p95_ms\": " << row.p95Ms << ", \"mpixels_per_s\": "
+            << megapixels / (row.medianMs / 1000) << ", \"efficiency\": " << row.efficiency << " }";
+    }
+    out << "\n  ]\n}" << endl;
+}
+
+// Usage: mpirun -np N backend_benchmark [--megapixels 1,16,100] [--kernels 3,7,...]
+//   [--backends sequential,openmp,mpi,hybrid] [--workers 1,2,4] [--weak] [--high-pass]
+//   [--warmup N] [--repeats N] [--output saturate|sharpen[,alpha]|response]
+//   [--csv file] [--json file] [options]
+int main(int argc, char** argv) {
+    // Hybrid needs the main thread of each rank to own MPI
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    Settings settings;
+    hpf::ExecutionPolicy base;
+    if (!parseArgs(argc, argv, settings, base)) {
+        MPI_Finalize();
+        return 1;
+    }
+    if (provided < MPI_THREAD_FUNNELED) {
+        settings.backends.erase(remove(settings.backends.begin(), settings.backends.end(), hpf::Backend::Hybrid),
+            settings.backends.end());
+    }
+    const int maxThreads = base.threads > 0 ? base.threads : omp_get_max_threads();
+    if (rank == 0) {
+        cout << "# " << size << " ranks, " << maxThreads << " threads per rank, "
+            << hpf::simdLevelName(hpf::detectSimdLevel()) << ", " << settings.warmup << " warm-up and "
+            << settings.repeats << " timed runs per configuration" << endl;
+    }
+
+    vector<Row> rows;
+    for (hpf::Backend backend : settings.backends) {
+        const bool distributed = backend == hpf::Backend::MPI || backend == hpf::Backend::Hybrid;
+        vector<int> workers = !settings.workers.empty() ? settings.workers :
+            backend == hpf::Backend::Sequential ? vector<int>{ 1 } : powersOfTwo(distributed ? size : maxThreads);
+
+        for (double megapixels : settings.megapixels) {
+            for (int kernelSize : settings.kernels) {
+                double baseTime = 0;
+                int baseWorkers = 0;
+                for (int count : workers) {
+                    if (distributed && count > size) {
+                        continue;
+                    }
+
+                    // Ranks taking part; the others wait for the next configuration
+                    int ranks = distributed ? count : 1;
+                    MPI_Comm comm;
+                    MPI_Comm_split(MPI_COMM_WORLD, rank < ranks ? 0 : MPI_UNDEFINED, rank, &comm);
+                    if (comm != MPI_COMM_NULL) {
+                        hpf::ExecutionPolicy policy = base;
+                        policy.backend = backend;
+                        policy.comm = comm;
+                        policy.threads = backend == hpf::Backend::OpenMP ? count :
+                            backend == hpf::Backend::Hybrid ? maxThreads : 1;
+
+                        // Rank 0 builds the image and the plan, with random
+                        // integer taps unless the high-pass kernel is asked for
+                        double pixels = settings.weak ? megapixels * count : megapixels;
+                        cv::Mat image;
+                        hpf::FilterPlan plan;
+                        if (rank == 0) {
+                            image.create(imageSize(pixels), CV_8UC3);
+                            cv::randu(image, 0, 256);
+                            hpf::Kernel kernel = hpf::generateHighPassKernel(kernelSize);
+                            if (!settings.highPass) {
+                                cv::Mat taps(kernelSize, kernelSize, CV_32F);
+                                cv::randu(taps, -4, 5);
+                                for (int m = 0; m < kernelSize; ++m) {
+                                    for (int n = 0; n < kernelSize; ++n) {
+                                        taps.at<float>(m, n) = float(int(taps.at<float>(m, n)));
+                                    }
+                                }
+                                kernel = hpf::makeKernel(taps);
+                            }
+                            hpf::PlanOptions options;
+                            options.imageSize = image.size();
+                            plan = hpf::makeFilterPlan(kernel, options);
+                            hpf::parseOutputMode(settings.outputMode, plan);
+                        }
+                        hpf::broadcastPlan(plan, 0, comm);
+
+                        vector<double> times;
+                        if (!plan.kernel.empty()) {
+                            times = measure(image, plan, policy, comm, settings);
+                        }
+                        if (rank == 0 && !times.empty()) {
+                            Row row{ hpf::backendName(backend), hpf::describePlan(plan), image.size(), kernelSize,
+                                ranks, policy.threads, percentile(times, 0.5), percentile(times, 0.95), 1.0 };
+
+                            // Against the fewest workers measured: strong scaling
+                            // keeps the work and divides the time, weak scaling
+                            // grows the work and keeps the time
+                            if (baseWorkers == 0) {
+                                baseTime = row.medianMs;
+                                baseWorkers = count;
+                            }
+                            row.efficiency = settings.weak ? baseTime / row.medianMs :
+                                baseTime * baseWorkers / (row.medianMs * count);
+                            rows.push_back(row);
+                            cout << "# " << row.backend << " " << row.size.width << "x" << row.size.height << " kernel "
+                                << kernelSize << " " << ranks << "x" << row.threads << ": median " << row.medianMs
+                                << " ms, p95 " << row.p95Ms << " ms, efficiency " << row.efficiency << endl;
+                        }
+                        MPI_Comm_free(&comm);
+                    }
+                    MPI_Barrier(MPI_COMM_WORLD);
+                }
+            }
+        }
+    }
+
+    // Results for tracking across releases
+    if (rank == 0) {
+        if (!settings.csvPath.empty()) {
+            ofstream csv(settings.csvPath);
+            writeCsv(csv, rows, settings.weak);
+        }
+        else {
+            writeCsv(cout, rows, settings.weak);
+        }
+        if (!settings.jsonPath.empty()) {
+            ofstream json(settings.jsonPath);
+            writeJson(json, rows, settings.weak);
+        }
+    }
+    if (!base.tracePath.empty()) {
+        hpf::writeTrace(base.tracePath, MPI_COMM_WORLD);
+    }
+    MPI_Finalize();
+    return 0;
+}
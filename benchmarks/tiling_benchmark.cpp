@@ -0,0 +1,166 @@
+#include <opencv2/core.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <omp.h>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "filter_engine/filter_engine.hpp"
+#include "filter_engine/tiling.hpp"
+
+using namespace std;
+
+// Runs per configuration, the fastest one is reported
+static const int RUNS = 3;
+
+// Hardware cache miss counter of this process and the threads it starts
+// afterwards. Reads -1 where perf events are unavailable.
+class MissCounter {
+public:
+    MissCounter(unsigned type, unsigned long long config) {
+#if defined(__linux__)
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+        (void)type;
+        (void)config;
+#endif
+    }
+
+    ~MissCounter() {
+#if defined(__linux__)
+        if (fd >= 0) {
+            close(fd);
+        }
+#endif
+    }
+
+    void start() {
+#if defined(__linux__)
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    long long stop() {
+        long long count = -1;
+#if defined(__linux__)
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+                count = -1;
+            }
+        }
+#endif
+        return count;
+    }
+
+private:
+    int fd = -1;
+};
+
+struct Result {
+    double ms;
+    long long l1Misses;
+    long long llcMisses;
+};
+
+static Result run(const cv::Mat& image, const hpf::FilterPlan& plan, const hpf::ExecutionPolicy& policy,
+    MissCounter& l1, MissCounter& llc) {
+    Result best{ 0, -1, -1 };
+    for (int r = 0; r < RUNS; ++r) {
+        l1.start();
+        llc.start();
+        double start = omp_get_wtime();
+        cv::Mat response = hpf::convolve(image, plan, policy);
+        double ms = (omp_get_wtime() - start) * 1000;
+        long long l1Misses = l1.stop();
+        long long llcMisses = llc.stop();
+        if (r == 0 || ms < best.ms) {
+            best = Result{ ms, l1Misses, llcMisses };
+        }
+    }
+    return best;
+}
+
+// Usage: tiling_benchmark [width height [kernel sizes...]]
+int main(int argc, char** argv) {
+#if defined(__linux__)
+    // Counters have to exist before OpenMP starts its threads to follow them
+    MissCounter l1(PERF_TYPE_HW_CACHE,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    MissCounter llc(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+#else
+    MissCounter l1(0, 0);
+    MissCounter llc(0, 0);
+#endif
+
+    // 8K UHD by default
+    cv::Size imageSize(7680, 4320);
+    if (argc >= 3) {
+        imageSize = cv::Size(atoi(argv[1]), atoi(argv[2]));
+    }
+    vector<int> sizes;
+    for (int i = 3; i < argc; ++i) {
+        sizes.push_back(atoi(argv[i]));
+    }
+    if (sizes.empty()) {
+        sizes = { 3, 9, 25 };
+    }
+
+    cv::Mat image(imageSize, CV_8UC3);
+    cv::randu(image, 0, 256);
+    hpf::CacheSizes caches = hpf::detectCacheSizes();
+    cout << "Image " << imageSize.width << "x" << imageSize.height << ", " << omp_get_max_threads()
+        << " threads, L1 " << caches.l1 / 1024 << " KiB, L2 " << caches.l2 / 1024 << " KiB" << endl;
+    cout << "kernel,mode,tile,ms,l1_misses,llc_misses" << endl;
+
+    for (int size : sizes) {
+        // Random integer taps keep the plan on the direct path
+        cv::Mat taps(size, size, CV_32F);
+        cv::randu(taps, -4, 5);
+        for (int m = 0; m < size; ++m) {
+            for (int n = 0; n < size; ++n) {
+                taps.at<float>(m, n) = float(int(taps.at<float>(m, n)));
+            }
+        }
+        hpf::Kernel kernel = hpf::makeKernel(taps);
+        if (kernel.empty()) {
+            continue;
+        }
+        hpf::PlanOptions options;
+        options.imageSize = imageSize;
+        options.allowFFT = false;
+        hpf::FilterPlan plan = hpf::makeFilterPlan(kernel, options);
+
+        hpf::ExecutionPolicy rows;
+        rows.backend = hpf::Backend::OpenMP;
+        hpf::ExecutionPolicy tiles = rows;
+        tiles.tiled = true;
+        cv::Size tile = hpf::chooseTileSize(plan, image.channels(), imageSize, caches);
+
+        Result r = run(image, plan, rows, l1, llc);
+        Result t = run(image, plan, tiles, l1, llc);
+        cout << size << "x" << size << ",rows,full," << r.ms << "," << r.l1Misses << "," << r.llcMisses << endl;
+        cout << size << "x" << size << ",tiles," << tile.width << "x" << tile.height << "," << t.ms << ","
+            << t.l1Misses << "," << t.llcMisses << endl;
+    }
+    return 0;
+}
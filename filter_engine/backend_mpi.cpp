@@ -0,0 +1,527 @@
+#include "filter_engine.hpp"
+#include "strips.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace hpf {
+
+// Tags of the halo rows between ranks and of the dynamic distribution:
+// block index (STOP when done) and its input window to a worker, block index
+// and response rows back to rank 0
+static const int HALO_TAG = 1;
+static const int TASK_TAG = 2;
+static const int WINDOW_TAG = 3;
+static const int RESULT_TAG = 4;
+static const int RESPONSE_TAG = 5;
+static const int STOP = -1;
+
+// Assignments a worker of the dynamic distribution holds at once: the block
+// it filters and the next one
+static const int PREFETCH_DEPTH = 2;
+
+// Default dynamic block height: enough blocks per rank to even out speed
+// differences, and not much less than the kernel so the halo stays cheap
+static const int BLOCKS_PER_RANK = 8;
+static const int MIN_BLOCK_ROWS = 16;
+
+// Start filling the halo rows of band (image rows from window.y) from the
+// ranks owning them, and sending the rows this rank owns that other windows
+// need. Only the owned rows have to be present in band beforehand; the halo
+// rows are there once the returned requests complete.
+static std::vector<MPI_Request> startHaloExchange(cv::Mat& band, const Strip& window, const std::vector<Strip>& owned,
+    const std::vector<Strip>& windows, MPI_Datatype row, int rank, MPI_Comm comm) {
+    std::vector<MPI_Request> requests;
+    for (int other = 0; other < int(owned.size()); ++other) {
+        if (other == rank) {
+            continue;
+        }
+        // Rows the other rank owns inside this window
+        Strip in = intersect(owned[other], window);
+        if (in.height > 0) {
+            requests.emplace_back();
+            MPI_Irecv(band.ptr(in.y - window.y), in.height, row, other, HALO_TAG, comm, &requests.back());
+        }
+        // Rows this rank owns inside the other window
+        Strip out = intersect(owned[rank], windows[other]);
+        if (out.height > 0) {
+            requests.emplace_back();
+            MPI_Isend(band.ptr(out.y - window.y), out.height, row, other, HALO_TAG, comm, &requests.back());
+        }
+    }
+    return requests;
+}
+
+// Rows of strip whose kernel window stays inside the strip, so they can be
+// filtered before the halo arrives. Starts and ends at multiples of alignment
+// from strip.y; empty if there are no such rows.
+static Strip interiorStrip(const Strip& strip, int radius, int alignment, int rows) {
+    int top = strip.y > 0 ? radius : 0;
+    int bottom = strip.end() < rows ? radius : 0;
+    int first = (top + alignment - 1) / alignment * alignment;
+    int last = std::max(strip.height - bottom, 0) / alignment * alignment;
+    return last > first ? Strip{ strip.y + first, last - first } : Strip{ strip.y, 0 };
+}
+
+// Filter rows of the image, threaded across the rank in the hybrid backend
+static void filterPart(const SourceBand& src, const FilterPlan& plan, const cv::Rect& roi, cv::Mat& dst,
+    const ExecutionPolicy& policy) {
+    TraceScope phase("filter", "compute");
+    if (policy.backend == Backend::Hybrid) {
+        filterRegionOpenMP(src, plan, roi, dst, policy);
+    }
+    else {
+        filterRegion(src, plan, roi, dst);
+    }
+}
+
+// Image shape shared by the root and the MPI datatypes of its rows
+struct RowLayout {
+    int rows;
+    int cols;
+    int type;
+    int responseType;
+    MPI_Datatype imageRow;
+    MPI_Datatype responseRow;
+};
+
+// One balanced strip per rank
+static cv::Mat distributeStatic(const cv::Mat& image, const FilterPlan& plan, const RowLayout& layout,
+    const ExecutionPolicy& policy) {
+    MPI_Comm comm = policy.comm;
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    // Every rank owns a strip, split at multiples of rowAlignment() so every
+    // rank count gives exactly the single process response. Rank 0 reads its
+    // halo from the image, so only the other windows take part in the exchange.
+    int alignment = rowAlignment(plan);
+    std::vector<Strip> owned(size), windows(size);
+    for (int r = 0; r < size; ++r) {
+        owned[r] = partStrip(r, size, layout.rows, alignment);
+        windows[r] = r == 0 ? owned[r] : haloStrip(owned[r], plan.kernel.radiusY(), layout.rows);
+    }
+
+    // Strips of the other ranks in rows; rank 0 neither sends nor receives its own
+    std::vector<int> counts(size, 0), displacements(size, 0);
+    for (int r = 1; r < size; ++r) {
+        counts[r] = owned[r].height;
+        displacements[r] = owned[r].y;
+    }
+
+    const Strip& strip = owned[rank];
+    const Strip& window = windows[rank];
+    cv::Mat processedImage;
+    if (rank == 0) {
+        // Hand every rank the rows it owns, the halos come from its neighbours
+        cv::Mat source = image.isContinuous() ? image : image.clone();
+        {
+            TraceScope phase("scatter", "mpi", (layout.rows - strip.height) * source.step[0]);
+            MPI_Scatterv(source.data, counts.data(), displacements.data(), layout.imageRow, nullptr, 0, layout.imageRow, 0, comm);
+        }
+        cv::Mat band = source.rowRange(strip.y, strip.end());
+        std::vector<MPI_Request> halo = startHaloExchange(band, window, owned, windows, layout.imageRow, rank, comm);
+
+        // Collect the other strips straight into their rows of the result
+        // while filtering the own strip, which the gather leaves untouched
+        processedImage.create(layout.rows, layout.cols, layout.responseType);
+        MPI_Request gather;
+        MPI_Igatherv(nullptr, 0, layout.responseRow, processedImage.data, counts.data(), displacements.data(),
+            layout.responseRow, 0, comm, &gather);
+        if (strip.height > 0) {
+            cv::Mat out = processedImage.rowRange(strip.y, strip.end());
+            filterPart(SourceBand{ source, 0, layout.rows }, plan, cv::Rect(0, strip.y, layout.cols, strip.height), out, policy);
+        }
+        TraceScope phase("gather wait", "wait", (layout.rows - strip.height) * processedImage.step[0]);
+        MPI_Waitall(int(halo.size()), halo.data(), MPI_STATUSES_IGNORE);
+        MPI_Wait(&gather, MPI_STATUS_IGNORE);
+    }
+    else {
+        // Own rows from the root into the middle of the window, halo rows from
+        // the neighbours
+        cv::Mat band(window.height, layout.cols, layout.type);
+        {
+            TraceScope phase("scatter", "mpi", strip.height * band.step[0]);
+            MPI_Scatterv(nullptr, nullptr, nullptr, layout.imageRow, band.ptr(strip.y - window.y), strip.height, layout.imageRow, 0, comm);
+        }
+        std::vector<MPI_Request> halo = startHaloExchange(band, window, owned, windows, layout.imageRow, rank, comm);
+
+        // Filter the rows that need no halo while it arrives, then the rest
+        cv::Mat processedSubImage(strip.height, layout.cols, layout.responseType);
+        SourceBand src{ band, window.y, layout.rows };
+        auto filterRows = [&](int y0, int y1) {
+            if (y1 > y0) {
+                cv::Mat out = processedSubImage.rowRange(y0 - strip.y, y1 - strip.y);
+                filterPart(src, plan, cv::Rect(0, y0, layout.cols, y1 - y0), out, policy);
+            }
+        };
+        Strip interior = interiorStrip(strip, plan.kernel.radiusY(), alignment, layout.rows);
+        filterRows(interior.y, interior.end());
+        {
+            TraceScope phase("halo wait", "wait", (window.height - strip.height) * band.step[0]);
+            MPI_Waitall(int(halo.size()), halo.data(), MPI_STATUSES_IGNORE);
+        }
+        if (interior.height > 0) {
+            filterRows(strip.y, interior.y);
+            filterRows(interior.end(), strip.end());
+        }
+        else {
+            filterRows(strip.y, strip.end());
+        }
+
+        // Return the strip to the root
+        TraceScope phase("gather", "mpi", strip.height * processedSubImage.step[0]);
+        MPI_Request gather;
+        MPI_Igatherv(processedSubImage.data, strip.height, layout.responseRow, nullptr, nullptr, nullptr,
+            layout.responseRow, 0, comm, &gather);
+        MPI_Wait(&gather, MPI_STATUS_IGNORE);
+    }
+    return processedImage;
+}
+
+// Rows of block index of blockRows rows each
+static Strip blockStrip(int index, int blockRows, int rows) {
+    int y = index * blockRows;
+    return Strip{ y, std::min(blockRows, rows - y) };
+}
+
+// Blocks handed out on demand by rank 0, which filters blocks itself between
+// serving the others. Every worker holds PREFETCH_DEPTH assignments, so the
+// next block is already there when it finishes one.
+static cv::Mat distributeDynamic(const cv::Mat& image, const FilterPlan& plan, const RowLayout& layout,
+    const ExecutionPolicy& policy) {
+    MPI_Comm comm = policy.comm;
+    int blockRows = policy.blockRows;
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    const int ry = plan.kernel.radiusY();
+
+    // Blocks start at multiples of rowAlignment() so the response stays exact
+    int alignment = rowAlignment(plan);
+    if (blockRows <= 0) {
+        blockRows = std::max({ MIN_BLOCK_ROWS, plan.kernel.rows(), layout.rows / (size * BLOCKS_PER_RANK) });
+    }
+    blockRows = (blockRows + alignment - 1) / alignment * alignment;
+    const int blocks = (layout.rows + blockRows - 1) / blockRows;
+
+    int filtered = 0;
+    double busy = 0, idle = 0;
+    cv::Mat processedImage;
+
+    if (rank == 0) {
+        cv::Mat source = image.isContinuous() ? image : image.clone();
+        processedImage.create(layout.rows, layout.cols, layout.responseType);
+        SourceBand src{ source, 0, layout.rows };
+
+        // Index of every block as a stable send buffer
+        std::vector<int> blockIds(blocks);
+        for (int b = 0; b < blocks; ++b) {
+            blockIds[b] = b;
+        }
+        std::vector<MPI_Request> sends;
+        std::vector<bool> stopped(size, false);
+        int next = 0, done = 0;
+
+        // Next block with its input window, or the stops once none is left
+        auto assign = [&](int worker) {
+            if (next < blocks) {
+                Strip window = haloStrip(blockStrip(next, blockRows, layout.rows), ry, layout.rows);
+                TraceScope phase("assign", "mpi", window.height * source.step[0]);
+                sends.emplace_back();
+                MPI_Isend(&blockIds[next], 1, MPI_INT, worker, TASK_TAG, comm, &sends.back());
+                sends.emplace_back();
+                MPI_Isend(source.ptr(window.y), window.height, layout.imageRow, worker, WINDOW_TAG, comm, &sends.back());
+                ++next;
+            }
+            else if (!stopped[worker]) {
+                // One stop per prefetch slot the worker keeps posted
+                for (int slot = 0; slot < PREFETCH_DEPTH; ++slot) {
+                    sends.emplace_back();
+                    MPI_Isend(&STOP, 1, MPI_INT, worker, TASK_TAG, comm, &sends.back());
+                    sends.emplace_back();
+                    MPI_Isend(source.data, 0, layout.imageRow, worker, WINDOW_TAG, comm, &sends.back());
+                }
+                stopped[worker] = true;
+            }
+        };
+
+        // Finished block of a worker straight into the result, then its next one
+        auto collect = [&](int worker) {
+            TraceScope phase("collect", "mpi");
+            int b;
+            MPI_Recv(&b, 1, MPI_INT, worker, RESULT_TAG, comm, MPI_STATUS_IGNORE);
+            Strip block = blockStrip(b, blockRows, layout.rows);
+            MPI_Recv(processedImage.ptr(block.y), block.height, layout.responseRow, worker, RESPONSE_TAG, comm,
+                MPI_STATUS_IGNORE);
+            phase.addBytes(block.height * processedImage.step[0]);
+            ++done;
+            assign(worker);
+        };
+
+        for (int slot = 0; slot < PREFETCH_DEPTH; ++slot) {
+            for (int worker = 1; worker < size; ++worker) {
+                assign(worker);
+            }
+        }
+
+        while (done + filtered < blocks) {
+            // Serve finished workers first so they never run dry
+            int ready;
+            MPI_Status status;
+            MPI_Iprobe(MPI_ANY_SOURCE, RESULT_TAG, comm, &ready, &status);
+            if (ready) {
+                collect(status.MPI_SOURCE);
+                continue;
+            }
+
+            // Otherwise filter a block here
+            if (next < blocks) {
+                Strip block = blockStrip(next++, blockRows, layout.rows);
+                double start = MPI_Wtime();
+                cv::Mat out = processedImage.rowRange(block.y, block.end());
+                filterPart(src, plan, cv::Rect(0, block.y, layout.cols, block.height), out, policy);
+                busy += MPI_Wtime() - start;
+                ++filtered;
+                continue;
+            }
+
+            // Nothing left to filter, wait for the workers
+            double start = MPI_Wtime();
+            {
+                TraceScope phase("result wait", "wait");
+                MPI_Probe(MPI_ANY_SOURCE, RESULT_TAG, comm, &status);
+            }
+            idle += MPI_Wtime() - start;
+            collect(status.MPI_SOURCE);
+        }
+        MPI_Waitall(int(sends.size()), sends.data(), MPI_STATUSES_IGNORE);
+    }
+    else {
+        // Assignment slots: block index and its input window
+        struct Slot {
+            int block;
+            cv::Mat window;
+            MPI_Request requests[2];
+        };
+        // Result buffers, one per slot, each free once its sends completed
+        struct Result {
+            int block;
+            cv::Mat response;
+            MPI_Request requests[2] = { MPI_REQUEST_NULL, MPI_REQUEST_NULL };
+        };
+        const int maxWindowRows = std::min(blockRows + 2 * ry, layout.rows);
+        Slot slots[PREFETCH_DEPTH];
+        Result results[PREFETCH_DEPTH];
+        auto post = [&](Slot& slot) {
+            MPI_Irecv(&slot.block, 1, MPI_INT, 0, TASK_TAG, comm, &slot.requests[0]);
+            MPI_Irecv(slot.window.data, maxWindowRows, layout.imageRow, 0, WINDOW_TAG, comm, &slot.requests[1]);
+        };
+        for (int s = 0; s < PREFETCH_DEPTH; ++s) {
+            slots[s].window.create(maxWindowRows, layout.cols, layout.type);
+            results[s].response.create(blockRows, layout.cols, layout.responseType);
+            post(slots[s]);
+        }
+
+        for (int current = 0;; current = (current + 1) % PREFETCH_DEPTH) {
+            Slot& slot = slots[current];
+            Result& result = results[current];
+            double start = MPI_Wtime();
+            {
+                TraceScope phase("block wait", "wait");
+                MPI_Waitall(2, slot.requests, MPI_STATUSES_IGNORE);
+                MPI_Waitall(2, result.requests, MPI_STATUSES_IGNORE);
+            }
+            idle += MPI_Wtime() - start;
+
+            if (slot.block == STOP) {
+                // The other slots hold the remaining stops
+                for (int s = 1; s < PREFETCH_DEPTH; ++s) {
+                    Slot& other = slots[(current + s) % PREFETCH_DEPTH];
+                    MPI_Waitall(2, other.requests, MPI_STATUSES_IGNORE);
+                    MPI_Waitall(2, results[(current + s) % PREFETCH_DEPTH].requests, MPI_STATUSES_IGNORE);
+                }
+                break;
+            }
+
+            // Filter the block and send it back, the next assignment is already posted
+            Strip block = blockStrip(slot.block, blockRows, layout.rows);
+            Strip window = haloStrip(block, ry, layout.rows);
+            start = MPI_Wtime();
+            cv::Mat out = result.response.rowRange(0, block.height);
+            filterPart(SourceBand{ slot.window.rowRange(0, window.height), window.y, layout.rows }, plan,
+                cv::Rect(0, block.y, layout.cols, block.height), out, policy);
+            busy += MPI_Wtime() - start;
+            ++filtered;
+
+            result.block = slot.block;
+            MPI_Isend(&result.block, 1, MPI_INT, 0, RESULT_TAG, comm, &result.requests[0]);
+            MPI_Isend(result.response.data, block.height, layout.responseRow, 0, RESPONSE_TAG, comm, &result.requests[1]);
+            post(slot);
+        }
+    }
+
+    // Per-rank counts to the root
+    double mine[3] = { double(filtered), busy, idle };
+    std::vector<double> all(3 * size);
+    MPI_Gather(mine, 3, MPI_DOUBLE, all.data(), 3, MPI_DOUBLE, 0, comm);
+    SchedulerStats* stats = policy.stats;
+    if (rank == 0 && stats) {
+        stats->blocks.resize(size);
+        stats->busySeconds.resize(size);
+        stats->idleSeconds.resize(size);
+        for (int r = 0; r < size; ++r) {
+            stats->blocks[r] = int(all[3 * r]);
+            stats->busySeconds[r] = all[3 * r + 1];
+            stats->idleSeconds[r] = all[3 * r + 2];
+        }
+    }
+    return processedImage;
+}
+
+cv::Mat convolveMPI(const cv::Mat& image, const FilterPlan& plan, const ExecutionPolicy& policy) {
+    MPI_Comm comm = policy.comm;
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    // Threads inside a rank only work while the main thread may call MPI
+    if (policy.backend == Backend::Hybrid) {
+        int provided;
+        MPI_Query_thread(&provided);
+        if (provided < MPI_THREAD_FUNNELED) {
+            if (rank == 0) {
+                std::cerr << "Error: The hybrid backend needs MPI initialized with MPI_THREAD_FUNNELED." << std::endl;
+            }
+            return cv::Mat();
+        }
+    }
+
+    // Only the root knows the image: share its shape, zero rows if unusable
+    int shape[3] = { 0, 0, 0 };
+    if (rank == 0 && isSupportedImage(image)) {
+        shape[0] = image.rows;
+        shape[1] = image.cols;
+        shape[2] = image.type();
+    }
+    if (size > 1) {
+        MPI_Bcast(shape, 3, MPI_INT, 0, comm);
+    }
+    if (shape[0] == 0) {
+        return cv::Mat();
+    }
+
+    if (size == 1) {
+        // Only one process, apply the filter directly
+        if (policy.stats) {
+            *policy.stats = SchedulerStats{ { 1 }, { 0.0 }, { 0.0 } };
+        }
+        return policy.backend == Backend::Hybrid ? convolveOpenMP(image, plan, policy) : convolveSequential(image, plan);
+    }
+
+    // Whole rows of the image and of the response as one element, so counts
+    // stay small on huge images and strips move without staging copies
+    RowLayout layout{ shape[0], shape[1], shape[2], outputType(plan, CV_MAT_CN(shape[2])) };
+    MPI_Type_contiguous(int(layout.cols * CV_ELEM_SIZE(layout.type)), MPI_BYTE, &layout.imageRow);
+    MPI_Type_contiguous(int(layout.cols * CV_ELEM_SIZE(layout.responseType)), MPI_BYTE, &layout.responseRow);
+    MPI_Type_commit(&layout.imageRow);
+    MPI_Type_commit(&layout.responseRow);
+
+    cv::Mat processedImage = policy.distribution == Distribution::Dynamic ?
+        distributeDynamic(image, plan, layout, policy) :
+        distributeStatic(image, plan, layout, policy);
+
+    MPI_Type_free(&layout.imageRow);
+    MPI_Type_free(&layout.responseRow);
+    return processedImage;
+}
+
+void broadcastKernel(Kernel& kernel, int root, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    // Dimensions of the matrix in one message, then the taps
+    int dims[2] = { kernel.rows(), kernel.cols() };
+    MPI_Bcast(dims, 2, MPI_INT, root, comm);
+    if (dims[0] == 0) {
+        kernel = Kernel();
+        return;
+    }
+    if (rank != root) {
+        kernel.taps = cv::Mat(dims[0], dims[1], CV_32F);
+    }
+    MPI_Bcast(kernel.taps.data, dims[0] * dims[1], MPI_FLOAT, root, comm);
+}
+
+void broadcastPlan(FilterPlan& plan, int root, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    // Kernel shape, strategy and what it was chosen with, and what is stored
+    int fields[8] = { plan.kernel.rows(), plan.kernel.cols(), int(plan.strategy), int(plan.simdLevel), plan.rank,
+        plan.boxWeight, plan.centerWeight, int(plan.output) };
+    MPI_Bcast(fields, 8, MPI_INT, root, comm);
+    const int rows = fields[0], cols = fields[1];
+    if (rows == 0) {
+        plan = FilterPlan();
+        return;
+    }
+
+    // Every float of the plan in a second message: the taps, the sharpen
+    // weight and the separable terms as root decomposed them. The FFT
+    // spectrum is rebuilt, or taken from this rank's spectrum cache.
+    const Strategy strategy = Strategy(fields[2]);
+    const int terms = strategy == Strategy::Separable ? fields[4] : 0;
+    std::vector<float> values(size_t(rows) * cols + 1 + size_t(terms) * (rows + cols));
+    float* taps = values.data();
+    float* alpha = taps + size_t(rows) * cols;
+    float* columnTaps = alpha + 1;
+    float* rowTaps = columnTaps + size_t(terms) * rows;
+    if (rank == root) {
+        cv::Mat tapsView(rows, cols, CV_32F, taps);
+        plan.kernel.taps.copyTo(tapsView);
+        *alpha = plan.sharpenAlpha;
+        if (terms > 0) {
+            cv::Mat columnView(terms, rows, CV_32F, columnTaps), rowView(terms, cols, CV_32F, rowTaps);
+            plan.columnTaps.copyTo(columnView);
+            plan.rowTaps.copyTo(rowView);
+        }
+    }
+    MPI_Bcast(values.data(), int(values.size()), MPI_FLOAT, root, comm);
+    if (rank == root) {
+        return;
+    }
+
+    FilterPlan received;
+    received.kernel.taps = cv::Mat(rows, cols, CV_32F, taps).clone();
+    received.strategy = strategy;
+    received.rank = fields[4];
+    received.boxWeight = fields[5];
+    received.centerWeight = fields[6];
+    received.output = OutputMode(fields[7]);
+    received.sharpenAlpha = *alpha;
+    prepareDirect(received, SimdLevel(fields[3]));
+    if (strategy == Strategy::Separable) {
+        received.columnTaps = cv::Mat(terms, rows, CV_32F, columnTaps).clone();
+        received.rowTaps = cv::Mat(terms, cols, CV_32F, rowTaps).clone();
+    }
+    else if (strategy == Strategy::FFT) {
+        prepareFFT(received);
+    }
+    plan = received;
+}
+
+std::string describeStats(const SchedulerStats& stats) {
+    std::ostringstream text;
+    for (size_t r = 0; r < stats.blocks.size(); ++r) {
+        text << "rank " << r << ": " << stats.blocks[r] << " blocks, busy " << stats.busySeconds[r] * 1000
+            << " ms, idle " << stats.idleSeconds[r] * 1000 << " ms\n";
+    }
+    return text.str();
+}
+
+}
@@ -0,0 +1,135 @@
+#include "filter_engine.hpp"
+#include "tiling.hpp"
+
+#include <algorithm>
+#include <omp.h>
+
+namespace hpf {
+
+// Fewest rows handed to a thread at a time
+static const int MIN_BLOCK_ROWS = 16;
+
+// Blocks per thread, enough to even out the load while keeping the per-block
+// setup of running-sum strategies small
+static const int BLOCKS_PER_THREAD = 4;
+
+// Output tiles of region in row-major order
+struct TileGrid {
+    cv::Rect region;
+    cv::Size tile;
+    int tilesX;
+    int count;
+
+    cv::Rect operator[](int t) const {
+        int x = region.x + (t % tilesX) * tile.width;
+        int y = region.y + (t / tilesX) * tile.height;
+        return cv::Rect(x, y, std::min(tile.width, region.x + region.width - x), std::min(tile.height, region.y + region.height - y));
+    }
+};
+
+// Body of the parallel region, the same for every thread placement. Both
+// loops use the runtime schedule, so with a static schedule a tile of the
+// response is touched and filtered by the same thread.
+static void filterTiles(const SourceBand& src, const FilterPlan& plan, const TileGrid& grid, bool firstTouch,
+    cv::Mat& response) {
+    if (firstTouch) {
+#pragma omp for schedule(runtime)
+        for (int t = 0; t < grid.count; ++t) {
+            response(grid[t] - grid.region.tl()).setTo(cv::Scalar::all(0));
+        }
+    }
+
+    // Every tile writes straight into its part of the response; tiles go out
+    // in row-major order so neighbouring tiles share their halo rows in L2
+#pragma omp for schedule(runtime)
+    for (int t = 0; t < grid.count; ++t) {
+        cv::Rect roi = grid[t];
+        cv::Mat out = response(roi - grid.region.tl());
+        TraceScope phase("tile", "compute", out.total() * out.elemSize());
+        filterRegion(src, plan, roi, out);
+    }
+}
+
+cv::Mat convolveOpenMP(const cv::Mat& image, const FilterPlan& plan, const ExecutionPolicy& policy) {
+    cv::Mat response;
+    filterRegionOpenMP(SourceBand{ image, 0, image.rows }, plan, cv::Rect(0, 0, image.cols, image.rows), response, policy);
+    return response;
+}
+
+void filterRegionOpenMP(const SourceBand& src, const FilterPlan& plan, const cv::Rect& roi, cv::Mat& dst,
+    const ExecutionPolicy& policy) {
+    dst.create(roi.size(), outputType(plan, src.rows.channels()));
+    int threads = policy.threads > 0 ? policy.threads : omp_get_max_threads();
+
+    // Full-width row blocks, or 2-D tiles whose window stays in cache. FFT
+    // plans only match the other backends in blocks of rowAlignment() rows
+    // and box sums stream whole rows, so both keep row blocks whatever
+    // tileSize asks for, as chooseTileSize() does.
+    cv::Size tile = policy.tileSize;
+    if (plan.strategy == Strategy::FFT || plan.strategy == Strategy::BoxComplement) {
+        tile = cv::Size();
+    }
+    else if (policy.tiled && tile.empty()) {
+        static const CacheSizes caches = detectCacheSizes();
+        tile = chooseTileSize(plan, src.rows.channels(), roi.size(), caches);
+    }
+    if (!policy.tiled || tile.empty()) {
+        int targetBlocks = threads * BLOCKS_PER_THREAD;
+        int alignment = rowAlignment(plan);
+        int blockRows = std::max(MIN_BLOCK_ROWS, (roi.height + targetBlocks - 1) / targetBlocks);
+        tile = cv::Size(roi.width, (blockRows + alignment - 1) / alignment * alignment);
+    }
+    tile.width = std::min(tile.width, roi.width);
+    tile.height = std::min(tile.height, roi.height);
+    int tilesX = (roi.width + tile.width - 1) / tile.width;
+    int tilesY = (roi.height + tile.height - 1) / tile.height;
+    TileGrid grid{ roi, tile, tilesX, tilesX * tilesY };
+
+    // The runtime schedule of the parallel loops, restored afterwards.
+    // OpenMP 2.0 (MSVC /openmp) only reads it from OMP_SCHEDULE.
+#if _OPENMP >= 200805
+    omp_sched_t previousKind;
+    int previousChunk;
+    omp_get_schedule(&previousKind, &previousChunk);
+    switch (policy.schedule) {
+    case Schedule::Dynamic:
+        omp_set_schedule(omp_sched_dynamic, policy.chunk);
+        break;
+    case Schedule::Guided:
+        omp_set_schedule(omp_sched_guided, policy.chunk);
+        break;
+    case Schedule::Static:
+        omp_set_schedule(omp_sched_static, policy.chunk);
+        break;
+    case Schedule::Runtime:
+    default:
+        break;
+    }
+#endif
+
+    // proc_bind only takes constants, so one region per placement. Before
+    // OpenMP 4.0 placement is left to the runtime.
+    switch (policy.affinity) {
+#if _OPENMP >= 201307
+    case Affinity::Close:
+#pragma omp parallel num_threads(threads) proc_bind(close)
+        filterTiles(src, plan, grid, policy.firstTouch, dst);
+        break;
+    case Affinity::Spread:
+#pragma omp parallel num_threads(threads) proc_bind(spread)
+        filterTiles(src, plan, grid, policy.firstTouch, dst);
+        break;
+#endif
+    case Affinity::Default:
+    default:
+#pragma omp parallel num_threads(threads)
+        filterTiles(src, plan, grid, policy.firstTouch, dst);
+        break;
+    }
+
+#if _OPENMP >= 200805
+    omp_set_schedule(previousKind, previousChunk);
+#endif
+}
+
+}
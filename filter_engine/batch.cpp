@@ -0,0 +1,647 @@
+#include "batch.hpp"
+
+#include <opencv2/imgcodecs.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+#include "bounded_queue.hpp"
+#include "trace.hpp"
+
+namespace hpf {
+
+// Tags of the image-level distribution: image index (STOP when done) to a
+// worker, index and outcome back to rank 0
+static const int IMAGE_TAG = 10;
+static const int REPORT_TAG = 11;
+static const int STOP = -1;
+
+// How long rank 0 waits for a decoded image of its own before it serves the
+// workers again
+static const std::chrono::microseconds SERVE_INTERVAL(200);
+
+// Outcome of one image on one rank
+enum ImageStatus {
+    IMAGE_DONE,
+    IMAGE_FAILED,
+    IMAGE_SPLIT  // Too large for one rank, left for all ranks together
+};
+
+// Plans built so far, one per image size
+using PlanCache = std::map<std::pair<int, int>, FilterPlan>;
+
+static const FilterPlan& planFor(PlanCache& plans, const Kernel& kernel, cv::Size size, const BatchOptions& batch) {
+    std::pair<int, int> key(size.width, size.height);
+    auto found = plans.find(key);
+    if (found == plans.end()) {
+        PlanOptions options;
+        options.imageSize = size;
+        FilterPlan plan = cachedFilterPlan(kernel, options);
+        plan.output = batch.output == OutputMode::Sharpen ? OutputMode::Sharpen : OutputMode::Saturate;
+        plan.sharpenAlpha = batch.sharpenAlpha;
+        found = plans.emplace(key, plan).first;
+    }
+    return found->second;
+}
+
+static bool isImageFile(const std::filesystem::path& path) {
+    static const char* const extensions[] = { ".bmp", ".jpeg", ".jpg", ".jp2", ".pbm", ".pgm", ".png", ".ppm",
+        ".tif", ".tiff", ".webp" };
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+        [](unsigned char c) { return char(std::tolower(c)); });
+    return std::find(std::begin(extensions), std::end(extensions), extension) != std::end(extensions);
+}
+
+std::vector<std::string> listImages(const std::string& path) {
+    namespace fs = std::filesystem;
+    std::vector<std::string> paths;
+    std::error_code error;
+    if (fs::is_directory(path, error)) {
+        for (const fs::directory_entry& entry : fs::directory_iterator(path, error)) {
+            if (entry.is_regular_file(error) && isImageFile(entry.path())) {
+                paths.push_back(entry.path().string());
+            }
+        }
+        std::sort(paths.begin(), paths.end());
+        return paths;
+    }
+
+    std::ifstream manifest(path);
+    if (!manifest) {
+        std::cerr << "Error: Could not open the image directory or manifest " << path << "." << std::endl;
+        return paths;
+    }
+    std::string line;
+    while (std::getline(manifest, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!line.empty() && line[0] != '#') {
+            paths.push_back(line);
+        }
+    }
+    return paths;
+}
+
+// Share the paths of root with every rank of comm as one newline separated buffer
+static std::vector<std::string> broadcastPaths(const std::vector<std::string>& paths, int root, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    std::string joined;
+    if (rank == root) {
+        for (const std::string& path : paths) {
+            joined += path + '\n';
+        }
+    }
+    int length = int(joined.size());
+    MPI_Bcast(&length, 1, MPI_INT, root, comm);
+    joined.resize(length);
+    MPI_Bcast(joined.data(), length, MPI_CHAR, root, comm);
+    if (rank == root) {
+        return paths;
+    }
+
+    std::vector<std::string> received;
+    std::istringstream lines(joined);
+    std::string line;
+    while (std::getline(lines, line)) {
+        received.push_back(line);
+    }
+    return received;
+}
+
+// Write the filtered image under the input file name; true if there is nothing to write
+static bool writeOutput(const cv::Mat& output, const std::string& path, const BatchOptions& options) {
+    if (options.outputDir.empty()) {
+        return true;
+    }
+    std::string target = (std::filesystem::path(options.outputDir) / std::filesystem::path(path).filename()).string();
+    if (!cv::imwrite(target, output)) {
+        std::cerr << "Error: Could not write " << target << "." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Image on its way from the decoders to the filter stage, empty if it could
+// not be read
+struct DecodedImage {
+    int index = -1;
+    cv::Mat image;
+};
+
+// Filtered image on its way from the filter stage to the encoders
+struct EncodeJob {
+    int index = -1;
+    cv::Mat output;
+};
+
+// Decode and encode threads around the filtering main thread of one rank.
+// The main thread keeps at most depth() images between decode() and
+// take(), so neither queue in front of it ever fills up. Without threaded
+// the main thread decodes in decode() and encodes in encode() itself.
+class ImagePipeline {
+public:
+    ImagePipeline(const std::vector<std::string>& paths, const BatchOptions& options, bool threaded) :
+        paths(paths), options(options), threaded(threaded), pending(options.queueDepth), decoded(options.queueDepth),
+        finished(options.queueDepth), decodeStats(options.decodeThreads), encodeStats(options.encodeThreads) {
+        if (!threaded) {
+            return;
+        }
+        for (int t = 0; t < options.decodeThreads; ++t) {
+            decoders.emplace_back([this, t] { decodeLoop(decodeStats[t]); });
+        }
+        if (!options.outputDir.empty()) {
+            for (int t = 0; t < options.encodeThreads; ++t) {
+                encoders.emplace_back([this, t] { encodeLoop(encodeStats[t]); });
+            }
+        }
+    }
+
+    ~ImagePipeline() { finish(); }
+
+    int depth() const { return options.queueDepth; }
+
+    void decode(int index) {
+        if (threaded) {
+            pending.push(index);
+            return;
+        }
+        DecodedImage item;
+        item.index = index;
+        read(item, decodeStats[0]);
+        decoded.push(std::move(item));
+    }
+
+    // Next decoded image, in decode completion order
+    bool take(DecodedImage& item, std::chrono::microseconds timeout) { return decoded.popFor(item, timeout); }
+    void take(DecodedImage& item) { decoded.pop(item); }
+
+    // Nothing is written without an output directory
+    void encode(int index, const cv::Mat& output) {
+        if (!encoders.empty()) {
+            finished.push(EncodeJob{ index, output });
+        }
+        else if (!threaded && !options.outputDir.empty()) {
+            write(EncodeJob{ index, output }, encodeStats[0]);
+        }
+    }
+
+    // Drain both queues and stop the threads
+    void finish() {
+        pending.close();
+        for (std::thread& thread : decoders) {
+            thread.join();
+        }
+        decoders.clear();
+        finished.close();
+        for (std::thread& thread : encoders) {
+            thread.join();
+        }
+        encoders.clear();
+    }
+
+    int failedWrites() const { return writeFailures.load(); }
+    StageStats decodeTotals() const { return sum(decodeStats); }
+    StageStats encodeTotals() const { return sum(encodeStats); }
+
+private:
+    void decodeLoop(StageStats& stats) {
+        for (;;) {
+            DecodedImage item;
+            auto start = std::chrono::steady_clock::now();
+            bool more = pending.pop(item.index);
+            stats.inputWaitSeconds += secondsSince(start);
+            if (!more) {
+                return;
+            }
+
+            read(item, stats);
+
+            start = std::chrono::steady_clock::now();
+            decoded.push(std::move(item));
+            stats.outputWaitSeconds += secondsSince(start);
+        }
+    }
+
+    void encodeLoop(StageStats& stats) {
+        for (;;) {
+            EncodeJob job;
+            auto start = std::chrono::steady_clock::now();
+            bool more = finished.pop(job);
+            stats.inputWaitSeconds += secondsSince(start);
+            if (!more) {
+                return;
+            }
+
+            write(job, stats);
+        }
+    }
+
+    void read(DecodedImage& item, StageStats& stats) {
+        auto start = std::chrono::steady_clock::now();
+        {
+            TraceScope phase("imread", "io");
+            item.image = cv::imread(paths[item.index], cv::IMREAD_COLOR);
+            phase.addBytes(item.image.total() * item.image.elemSize());
+        }
+        if (item.image.empty()) {
+            std::cerr << "Error: Could not open or read " << paths[item.index] << "." << std::endl;
+        }
+        stats.busySeconds += secondsSince(start);
+    }
+
+    void write(const EncodeJob& job, StageStats& stats) {
+        auto start = std::chrono::steady_clock::now();
+        {
+            TraceScope phase("imwrite", "io", job.output.total() * job.output.elemSize());
+            if (!writeOutput(job.output, paths[job.index], options)) {
+                ++writeFailures;
+            }
+        }
+        stats.busySeconds += secondsSince(start);
+    }
+
+    static StageStats sum(const std::vector<StageStats>& threads) {
+        StageStats total;
+        for (const StageStats& stats : threads) {
+            total.busySeconds += stats.busySeconds;
+            total.inputWaitSeconds += stats.inputWaitSeconds;
+            total.outputWaitSeconds += stats.outputWaitSeconds;
+        }
+        return total;
+    }
+
+    const std::vector<std::string>& paths;
+    const BatchOptions& options;
+    const bool threaded;
+    BoundedQueue<int> pending;
+    BoundedQueue<DecodedImage> decoded;
+    BoundedQueue<EncodeJob> finished;
+    std::vector<StageStats> decodeStats;
+    std::vector<StageStats> encodeStats;
+    std::atomic<int> writeFailures{ 0 };
+    std::vector<std::thread> decoders;
+    std::vector<std::thread> encoders;
+};
+
+bool parseBatchArgs(int argc, char** argv, ExecutionPolicy& policy, BatchOptions& options) {
+    // Everything else goes to parseExecutionArgs() with the program name
+    std::vector<char*> rest{ argv[0] };
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        int* count = option == "--decode-threads" ? &options.decodeThreads :
+            option == "--encode-threads" ? &options.encodeThreads :
+            option == "--queue-depth" ? &options.queueDepth : nullptr;
+        if (!count && option != "--split-pixels" && option != "--output") {
+            rest.push_back(argv[i]);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Error: Missing value for " << option << "." << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+        bool valid;
+        if (count) {
+            *count = std::atoi(value.c_str());
+            valid = *count > 0;
+        }
+        else if (option == "--output") {
+            FilterPlan modes;
+            valid = parseOutputMode(value, modes) && modes.output != OutputMode::Response;
+            options.output = modes.output;
+            options.sharpenAlpha = modes.sharpenAlpha;
+        }
+        else {
+            options.splitPixels = std::atof(value.c_str());
+            valid = options.splitPixels > 0;
+        }
+        if (!valid) {
+            std::cerr << "Error: Invalid value " << value << " for " << option << "." << std::endl;
+            return false;
+        }
+    }
+    return parseExecutionArgs(int(rest.size()), rest.data(), policy);
+}
+
+BatchStats filterBatch(const std::vector<std::string>& paths, const Kernel& kernel, const ExecutionPolicy& policy,
+    const BatchOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    BatchStats stats;
+    PlanCache plans;
+
+    // One process unless the policy spans ranks
+    const bool distributed = policy.backend == Backend::MPI || policy.backend == Backend::Hybrid;
+    MPI_Comm comm = policy.comm;
+    int rank = 0, size = 1;
+    if (distributed) {
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &size);
+    }
+    std::vector<std::string> shared = size > 1 ? broadcastPaths(paths, 0, comm) : paths;
+    const int count = int(shared.size());
+
+    // Whole images stay on their rank, threaded in the hybrid backend
+    ExecutionPolicy local = policy;
+    if (distributed) {
+        local.backend = policy.backend == Backend::Hybrid ? Backend::OpenMP : Backend::Sequential;
+    }
+
+    // A process that MPI grants less than MPI_THREAD_FUNNELED may only run
+    // one thread, so its main thread decodes and encodes as well
+    int initialized = 0, threadLevel = MPI_THREAD_FUNNELED;
+    MPI_Initialized(&initialized);
+    if (initialized) {
+        MPI_Query_thread(&threadLevel);
+    }
+    ImagePipeline pipeline(shared, options, threadLevel >= MPI_THREAD_FUNNELED);
+    const int depth = pipeline.depth();
+
+    // Rank 0 hands out images: the next one not handed out, the workers not
+    // stopped yet and the images each holds. Workers stop once rank 0 says so.
+    int next = 0;
+    int active = 0;
+    std::vector<int> held(size, 0);
+    bool stopped = false;
+
+    // Images left for all ranks, in pairs of index and the rank that decoded
+    // it (complete on rank 0), and up to depth of them kept decoded here
+    std::vector<int> splitImages;
+    std::map<int, cv::Mat> splitKept;
+
+    // Assignments and reports go out nonblocking, so rank 0 and a worker
+    // sending to each other at once never rely on MPI buffering the message.
+    // Every index is a stable send buffer, and so is every report a worker
+    // sends; all are waited for once the images are handed out.
+    std::vector<int> imageIds(rank == 0 && size > 1 ? count : 0);
+    for (int i = 0; i < int(imageIds.size()); ++i) {
+        imageIds[i] = i;
+    }
+    std::deque<std::array<int, 2>> reports;
+    std::vector<MPI_Request> sends;
+
+    // Refill the worker, or stop it once it holds nothing
+    auto assign = [&](int worker) {
+        if (next < count) {
+            sends.emplace_back();
+            MPI_Isend(&imageIds[next], 1, MPI_INT, worker, IMAGE_TAG, comm, &sends.back());
+            ++next;
+            ++held[worker];
+        }
+        else if (held[worker] == 0) {
+            sends.emplace_back();
+            MPI_Isend(&STOP, 1, MPI_INT, worker, IMAGE_TAG, comm, &sends.back());
+            --active;
+        }
+    };
+    if (rank == 0) {
+        for (int worker = 1; worker < size; ++worker) {
+            ++active;
+            for (int d = 0; d < depth && next < count; ++d) {
+                assign(worker);
+            }
+            if (held[worker] == 0) {
+                assign(worker);
+            }
+        }
+    }
+
+    // Answer the reports that arrived, after waiting for one if asked to
+    auto serve = [&](bool wait) {
+        while (active > 0) {
+            int ready = 1;
+            MPI_Status status;
+            if (wait) {
+                MPI_Probe(MPI_ANY_SOURCE, REPORT_TAG, comm, &status);
+                wait = false;
+            }
+            else {
+                MPI_Iprobe(MPI_ANY_SOURCE, REPORT_TAG, comm, &ready, &status);
+            }
+            if (!ready) {
+                return;
+            }
+            int report[2];
+            MPI_Recv(report, 2, MPI_INT, status.MPI_SOURCE, REPORT_TAG, comm, MPI_STATUS_IGNORE);
+            if (report[1] == IMAGE_SPLIT) {
+                splitImages.push_back(report[0]);
+                splitImages.push_back(status.MPI_SOURCE);
+            }
+            --held[status.MPI_SOURCE];
+            assign(status.MPI_SOURCE);
+        }
+    };
+
+    // Next image of this rank, false if none is there yet
+    auto nextIndex = [&](int& index) {
+        if (rank == 0) {
+            if (next >= count) {
+                return false;
+            }
+            index = next++;
+            return true;
+        }
+        int arrived = 0;
+        if (!stopped) {
+            MPI_Iprobe(0, IMAGE_TAG, comm, &arrived, MPI_STATUS_IGNORE);
+        }
+        if (!arrived) {
+            return false;
+        }
+        MPI_Recv(&index, 1, MPI_INT, 0, IMAGE_TAG, comm, MPI_STATUS_IGNORE);
+        stopped = index == STOP;
+        return !stopped;
+    };
+
+    int inFlight = 0;
+    for (;;) {
+        // Keep the decoders busy
+        if (rank == 0) {
+            serve(false);
+        }
+        int index;
+        while (inFlight < depth && nextIndex(index)) {
+            pipeline.decode(index);
+            ++inFlight;
+        }
+
+        // Nothing of its own left: rank 0 waits for the workers, a worker for
+        // its next images or the stop
+        if (inFlight == 0) {
+            if (rank == 0 ? active == 0 : stopped) {
+                break;
+            }
+            if (rank == 0) {
+                serve(true);
+            }
+            else {
+                MPI_Probe(0, IMAGE_TAG, comm, MPI_STATUS_IGNORE);
+            }
+            continue;
+        }
+
+        // Rank 0 only waits a moment so the workers never run dry
+        DecodedImage item;
+        auto waitStart = std::chrono::steady_clock::now();
+        if (rank == 0 && active > 0) {
+            bool arrived = pipeline.take(item, SERVE_INTERVAL);
+            stats.filter.inputWaitSeconds += secondsSince(waitStart);
+            if (!arrived) {
+                continue;
+            }
+        }
+        else {
+            TraceScope phase("image wait", "wait");
+            pipeline.take(item);
+            stats.filter.inputWaitSeconds += secondsSince(waitStart);
+        }
+        --inFlight;
+
+        ImageStatus status = IMAGE_FAILED;
+        if (!item.image.empty() && size > 1 && double(item.image.total()) >= options.splitPixels) {
+            status = IMAGE_SPLIT;
+            if (int(splitKept.size()) < depth) {
+                splitKept.emplace(item.index, item.image);
+            }
+        }
+        else if (!item.image.empty()) {
+            auto filterStart = std::chrono::steady_clock::now();
+            cv::Mat output;
+            // Named apart from the "filter" phase the backends record inside it
+            {
+                TraceScope phase("image", "compute", item.image.total() * item.image.elemSize());
+                output = convolve(item.image, planFor(plans, kernel, item.image.size(), options), local);
+            }
+            stats.filter.busySeconds += secondsSince(filterStart);
+            if (!output.empty()) {
+                status = IMAGE_DONE;
+                auto encodeStart = std::chrono::steady_clock::now();
+                pipeline.encode(item.index, output);
+                stats.filter.outputWaitSeconds += secondsSince(encodeStart);
+            }
+        }
+
+        if (status != IMAGE_SPLIT) {
+            ++stats.images;
+            stats.failed += status == IMAGE_FAILED;
+        }
+        if (rank == 0) {
+            if (status == IMAGE_SPLIT) {
+                splitImages.push_back(item.index);
+                splitImages.push_back(0);
+            }
+        }
+        else {
+            reports.push_back({ item.index, status });
+            sends.emplace_back();
+            MPI_Isend(reports.back().data(), 2, MPI_INT, 0, REPORT_TAG, comm, &sends.back());
+        }
+    }
+    if (!sends.empty()) {
+        MPI_Waitall(int(sends.size()), sends.data(), MPI_STATUSES_IGNORE);
+    }
+    pipeline.finish();
+    stats.failed += pipeline.failedWrites();
+    stats.decode = pipeline.decodeTotals();
+    stats.encode = pipeline.encodeTotals();
+
+    // Images too large for one rank, split into strips across all of them.
+    // The rank that decoded one scatters it, as rank 0 of a reordered
+    // communicator, so it is not read twice unless it was not kept.
+    int splitCount = int(splitImages.size()) / 2;
+    if (size > 1) {
+        MPI_Bcast(&splitCount, 1, MPI_INT, 0, comm);
+        splitImages.resize(2 * splitCount);
+        MPI_Bcast(splitImages.data(), 2 * splitCount, MPI_INT, 0, comm);
+    }
+    for (int i = 0; i < splitCount; ++i) {
+        const int index = splitImages[2 * i];
+        const int owner = splitImages[2 * i + 1];
+        ExecutionPolicy ordered = policy;
+        MPI_Comm_split(comm, 0, rank == owner ? 0 : rank + 1, &ordered.comm);
+
+        cv::Mat image;
+        FilterPlan plan;
+        if (rank == owner) {
+            auto kept = splitKept.find(index);
+            if (kept != splitKept.end()) {
+                image = kept->second;
+                splitKept.erase(kept);
+            }
+            else {
+                image = cv::imread(shared[index], cv::IMREAD_COLOR);
+            }
+            plan = planFor(plans, kernel, image.size(), options);
+        }
+        broadcastPlan(plan, 0, ordered.comm);
+        cv::Mat output = convolve(image, plan, ordered);
+        if (rank == owner) {
+            ++stats.images;
+            ++stats.split;
+            stats.failed += output.empty() || !writeOutput(output, shared[index], options);
+        }
+        MPI_Comm_free(&ordered.comm);
+    }
+
+    // Counts and stage times of every rank to rank 0
+    if (size > 1) {
+        StageStats* stages[3] = { &stats.decode, &stats.filter, &stats.encode };
+        double mine[12] = { double(stats.images), double(stats.failed), double(stats.split) };
+        for (int s = 0; s < 3; ++s) {
+            mine[3 + 3 * s] = stages[s]->busySeconds;
+            mine[4 + 3 * s] = stages[s]->inputWaitSeconds;
+            mine[5 + 3 * s] = stages[s]->outputWaitSeconds;
+        }
+        double all[12];
+        MPI_Reduce(mine, all, 12, MPI_DOUBLE, MPI_SUM, 0, comm);
+        if (rank == 0) {
+            stats.images = int(all[0]);
+            stats.failed = int(all[1]);
+            stats.split = int(all[2]);
+            for (int s = 0; s < 3; ++s) {
+                stages[s]->busySeconds = all[3 + 3 * s];
+                stages[s]->inputWaitSeconds = all[4 + 3 * s];
+                stages[s]->outputWaitSeconds = all[5 + 3 * s];
+            }
+        }
+    }
+
+    stats.seconds = secondsSince(start);
+    return stats;
+}
+
+std::string describeBatch(const BatchStats& stats) {
+    std::ostringstream text;
+    text << "images: " << stats.images << " (" << stats.split << " split across ranks, " << stats.failed
+        << " failed) in " << stats.seconds * 1000 << " ms, "
+        << (stats.seconds > 0 ? stats.images / stats.seconds : 0.0) << " images/s\n";
+    const char* names[3] = { "decode", "filter", "encode" };
+    const StageStats* stages[3] = { &stats.decode, &stats.filter, &stats.encode };
+    for (int s = 0; s < 3; ++s) {
+        text << names[s] << ": busy " << stages[s]->busySeconds * 1000 << " ms, waiting for input "
+            << stages[s]->inputWaitSeconds * 1000 << " ms, for output " << stages[s]->outputWaitSeconds * 1000
+            << " ms\n";
+    }
+    return text.str();
+}
+
+}
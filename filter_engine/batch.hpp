@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "filter_engine.hpp"
+
+namespace hpf {
+
+struct BatchOptions {
+    // Directory the filtered images are written to under their input file
+    // name, empty to only measure
+    std::string outputDir;
+
+    // With Backend::MPI and Hybrid on several ranks, images of at least this
+    // many pixels are split into strips across all ranks; smaller ones are
+    // filtered whole on one rank
+    double splitPixels = 8e6;
+
+    // Threads decoding the next images and encoding the last ones on every
+    // rank while its main thread filters, and the images each stage queue
+    // holds. Rank 0 hands every worker queueDepth images at a time.
+    int decodeThreads = 2;
+    int encodeThreads = 1;
+    int queueDepth = 4;
+
+    // 8-bit pixels written, finished by the filter itself: Saturate, or
+    // Sharpen with sharpenAlpha. Response is written saturated as well.
+    OutputMode output = OutputMode::Saturate;
+    float sharpenAlpha = 1.0f;
+};
+
+// Time of one pipeline stage, summed over its threads and all ranks: working,
+// waiting for its input queue and waiting for room in its output queue. A
+// filter stage waiting for input needs more decode threads, one waiting for
+// output more encode threads.
+struct StageStats {
+    double busySeconds = 0;
+    double inputWaitSeconds = 0;
+    double outputWaitSeconds = 0;
+};
+
+// Totals of a batch, complete on rank 0
+struct BatchStats {
+    int images = 0;
+    int split = 0;
+    int failed = 0;
+    double seconds = 0;
+    StageStats decode;
+    StageStats filter;
+    StageStats encode;
+};
+
+// Parse the batch options of the command line into options and the rest
+// with parseExecutionArgs() into policy:
+//   --decode-threads N  --encode-threads N  --queue-depth N  --split-pixels N
+//   --output saturate|sharpen[,alpha]
+bool parseBatchArgs(int argc, char** argv, ExecutionPolicy& policy, BatchOptions& options);
+
+// Image files of a directory in name order, or the paths listed one per line
+// in a manifest file (blank lines and lines starting with # skipped).
+// Prints the problem and returns an empty list if path is neither.
+std::vector<std::string> listImages(const std::string& path);
+
+// Filter every image of paths with the same kernel. Plans are built once per
+// image size and the OpenMP threads and MPI ranks stay up for the whole
+// batch. On every rank, decode threads read the next images and encode
+// threads write the finished ones while the main thread filters; if MPI
+// grants less than MPI_THREAD_FUNNELED, the main thread does both itself.
+// With Backend::MPI and Hybrid every rank of policy.comm must call it with
+// the same kernel, but only the paths of rank 0 are used: ranks ask rank 0
+// for the next images, decode and filter them themselves, and large images
+// are split across all ranks afterwards, scattered by the rank that decoded
+// them. Unreadable images are reported and counted as failed.
+BatchStats filterBatch(const std::vector<std::string>& paths, const Kernel& kernel, const ExecutionPolicy& policy,
+    const BatchOptions& options);
+
+// Image counts, time, throughput and one line per stage, for logs.
+std::string describeBatch(const BatchStats& stats);
+
+}
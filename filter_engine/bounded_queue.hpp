@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace hpf {
+
+// Bounded multi-producer, multi-consumer queue on a ring of sequenced cells
+// (Vyukov). tryPush() and tryPop() never lock; the blocking calls spin, then
+// yield, then sleep until they succeed. After close(), pop() returns false
+// once the queue is empty.
+template <typename T>
+class BoundedQueue {
+public:
+    // Holds at least capacity items, rounded up to a power of two
+    explicit BoundedQueue(size_t capacity) {
+        size_t cells = 2;
+        while (cells < capacity) {
+            cells <<= 1;
+        }
+        ring.reset(new Cell[cells]);
+        mask = cells - 1;
+        for (size_t i = 0; i < cells; ++i) {
+            ring[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Leaves value untouched and returns false if the queue is full
+    template <typename U>
+    bool tryPush(U&& value) {
+        size_t position = tail.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &ring[position & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t distance = intptr_t(sequence) - intptr_t(position);
+            if (distance == 0) {
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (distance < 0) {
+                return false;
+            }
+            else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::forward<U>(value);
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Returns false if the queue is empty
+    bool tryPop(T& value) {
+        size_t position = head.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &ring[position & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t distance = intptr_t(sequence) - intptr_t(position + 1);
+            if (distance == 0) {
+                if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (distance < 0) {
+                return false;
+            }
+            else {
+                position = head.load(std::memory_order_relaxed);
+            }
+        }
+        // Drop the cell's copy so large items are freed by their consumer
+        value = std::move(cell->value);
+        cell->value = T();
+        cell->sequence.store(position + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    void push(T value) {
+        for (int attempt = 0; !tryPush(std::move(value)); ++attempt) {
+            backoff(attempt);
+        }
+    }
+
+    // Waits for an item; false once the queue is closed and empty
+    bool pop(T& value) {
+        for (int attempt = 0;; ++attempt) {
+            if (tryPop(value)) {
+                return true;
+            }
+            if (closed.load(std::memory_order_acquire)) {
+                return tryPop(value);
+            }
+            backoff(attempt);
+        }
+    }
+
+    // Waits at most timeout for an item
+    bool popFor(T& value, std::chrono::microseconds timeout) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        for (int attempt = 0;; ++attempt) {
+            if (tryPop(value)) {
+                return true;
+            }
+            if (std::chrono::steady_clock::now() >= deadline) {
+                return false;
+            }
+            backoff(attempt);
+        }
+    }
+
+    // No more pushes will come
+    void close() { closed.store(true, std::memory_order_release); }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    static void backoff(int attempt) {
+        if (attempt < 64) {
+            return;
+        }
+        if (attempt < 128) {
+            std::this_thread::yield();
+        }
+        else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+    std::unique_ptr<Cell[]> ring;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> head{ 0 };
+    alignas(64) std::atomic<size_t> tail{ 0 };
+    std::atomic<bool> closed{ false };
+};
+
+}
@@ -0,0 +1,67 @@
+#include "convolution.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace hpf {
+
+void filterRegionBoxComplement(const SourceBand& src, const FilterPlan& plan, const cv::Rect& roi, cv::Mat& dst) {
+    const int cn = src.rows.channels();
+    const int ry = plan.kernel.radiusY();
+    const int rx = plan.kernel.radiusX();
+    CV_Assert(src.rows.depth() == CV_8U && cn <= 4);
+    CV_Assert(std::max(roi.y - ry, 0) >= src.firstRow &&
+        std::min(roi.y + roi.height + ry, src.imageRows) <= src.firstRow + src.rows.rows);
+
+    // Window columns in image coordinates and the part inside the image
+    int x0 = roi.x - rx;
+    int windowCols = roi.width + 2 * rx;
+    int inX0 = std::max(x0, 0), inX1 = std::min(roi.x + roi.width + rx, src.rows.cols);
+
+    // Sum of each window column over the kernel rows, zero outside the image
+    std::vector<int> columnSums(windowCols * cn, 0);
+    auto addRow = [&](int y, int sign) {
+        if (y < 0 || y >= src.imageRows) {
+            return;
+        }
+        const uchar* in = src.rows.ptr<uchar>(y - src.firstRow) + inX0 * cn;
+        int* sums = columnSums.data() + (inX0 - x0) * cn;
+        for (int x = 0; x < (inX1 - inX0) * cn; ++x) {
+            sums[x] += sign * in[x];
+        }
+    };
+
+    // Prime the column sums with every row of the first window but the last
+    for (int y = roi.y - ry; y < roi.y + ry; ++y) {
+        addRow(y, 1);
+    }
+
+    dst.create(roi.size(), CV_32FC(cn));
+
+    for (int i = 0; i < roi.height; ++i) {
+        int y = roi.y + i;
+        addRow(y + ry, 1);
+
+        const uchar* center = src.rows.ptr<uchar>(y - src.firstRow) + roi.x * cn;
+        float* out = dst.ptr<float>(i);
+
+        // Slide the box along the row
+        int box[4] = { 0, 0, 0, 0 };
+        for (int n = 0; n < 2 * rx; ++n) {
+            for (int c = 0; c < cn; ++c) {
+                box[c] += columnSums[n * cn + c];
+            }
+        }
+        for (int j = 0; j < roi.width; ++j) {
+            for (int c = 0; c < cn; ++c) {
+                box[c] += columnSums[(j + 2 * rx) * cn + c];
+                out[j * cn + c] = float(plan.boxWeight * box[c] + plan.centerWeight * center[j * cn + c]);
+                box[c] -= columnSums[j * cn + c];
+            }
+        }
+
+        addRow(y - ry, -1);
+    }
+}
+
+}
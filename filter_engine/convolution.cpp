@@ -0,0 +1,290 @@
+#include "convolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "cost_model.hpp"
+
+namespace hpf {
+
+// Largest magnitude float sums integers exactly up to
+static const double FLOAT_EXACT_LIMIT = 16777216.0;
+
+// Smallest kernel side for which FFT is considered; below it the transform
+// never pays off and the cost model is not worth calibrating
+static const int MIN_FFT_KERNEL = 9;
+
+// Image size assumed when the plan is built without one
+static const cv::Size DEFAULT_IMAGE_SIZE(4096, 4096);
+
+// Response bytes filterRegion() holds per band before it finishes them into
+// 8-bit pixels, about half a typical L2
+static const size_t FINISH_BYTES = 256 << 10;
+
+const char* strategyName(Strategy strategy) {
+    switch (strategy) {
+    case Strategy::BoxComplement:
+        return "box-complement";
+    case Strategy::Separable:
+        return "separable";
+    case Strategy::FFT:
+        return "fft";
+    case Strategy::Direct:
+    default:
+        return "direct";
+    }
+}
+
+// Check for kernels where every tap but the center has the same integer value.
+// The direct path sums integers in float, so the box path is only bit-identical
+// while every partial sum stays exactly representable.
+static bool isBoxComplement(const Kernel& kernel, int& boxWeight, int& centerWeight) {
+    if (kernel.rows() == 1 && kernel.cols() == 1) {
+        return false;
+    }
+
+    float outer = kernel.taps.at<float>(0, 0);
+    float center = kernel.taps.at<float>(kernel.radiusY(), kernel.radiusX());
+    if (outer != std::floor(outer) || center != std::floor(center)) {
+        return false;
+    }
+
+    double absSum = 0;
+    for (int m = 0; m < kernel.rows(); ++m) {
+        const float* k = kernel.taps.ptr<float>(m);
+        for (int n = 0; n < kernel.cols(); ++n) {
+            bool isCenter = m == kernel.radiusY() && n == kernel.radiusX();
+            if (!isCenter && k[n] != outer) {
+                return false;
+            }
+            absSum += std::fabs(k[n]);
+        }
+    }
+    if (absSum * 255 >= FLOAT_EXACT_LIMIT) {
+        return false;
+    }
+
+    boxWeight = int(outer);
+    centerWeight = int(center) - int(outer);
+    return true;
+}
+
+FilterPlan makeFilterPlan(const Kernel& kernel, const PlanOptions& options) {
+    FilterPlan plan;
+    plan.kernel = kernel;
+    if (kernel.empty()) {
+        return plan;
+    }
+    prepareDirect(plan, options.maxSimdLevel);
+
+    if (isBoxComplement(kernel, plan.boxWeight, plan.centerWeight)) {
+        plan.strategy = Strategy::BoxComplement;
+        return plan;
+    }
+
+    // Weigh the remaining strategies against each other. Small kernels only
+    // choose between Direct and Separable, which the uncalibrated tap counts
+    // decide well enough.
+    bool useFFT = options.allowFFT && std::max(kernel.rows(), kernel.cols()) >= MIN_FFT_KERNEL;
+    const CostModel& model = useFFT ? costModel() : CostModel();
+    cv::Size imageSize = options.imageSize.area() > 0 ? options.imageSize : DEFAULT_IMAGE_SIZE;
+
+    double bestCost = estimateCost(model, plan, Strategy::Direct, imageSize);
+    if (decomposeKernel(plan, options.rankTolerance)) {
+        double cost = estimateCost(model, plan, Strategy::Separable, imageSize);
+        if (cost < bestCost) {
+            plan.strategy = Strategy::Separable;
+            bestCost = cost;
+        }
+    }
+    if (useFFT) {
+        prepareFFT(plan);
+        double cost = estimateCost(model, plan, Strategy::FFT, imageSize);
+        if (cost < bestCost) {
+            plan.strategy = Strategy::FFT;
+            bestCost = cost;
+        }
+    }
+
+    // Drop the precomputed forms the chosen strategy does not use
+    if (plan.strategy != Strategy::Separable) {
+        plan.rank = 0;
+        plan.columnTaps.release();
+        plan.rowTaps.release();
+    }
+    if (plan.strategy != Strategy::FFT) {
+        plan.dftSize = 0;
+        plan.kernelSpectrum.release();
+    }
+    return plan;
+}
+
+std::string describePlan(const FilterPlan& plan) {
+    std::string description = std::string(strategyName(plan.strategy)) + " " +
+        std::to_string(plan.kernel.rows()) + "x" + std::to_string(plan.kernel.cols());
+    if (plan.strategy == Strategy::Direct && plan.simdLevel != SimdLevel::None) {
+        description += std::string(" ") + simdLevelName(plan.simdLevel) + (plan.shortAccumulator ? " int16" : plan.integerTaps ? " int32" : " float");
+        if (plan.staticLaplacian) {
+            description += " static-laplacian";
+        }
+        else if (plan.unrolledSize > 0) {
+            description += " unrolled";
+        }
+    }
+    if (plan.strategy == Strategy::Separable) {
+        description += " rank " + std::to_string(plan.rank);
+    }
+    if (plan.strategy == Strategy::FFT) {
+        description += " tile " + std::to_string(plan.dftSize);
+    }
+    return description;
+}
+
+// The float response of roi, whatever plan.output says
+static void filterResponse(const SourceBand& src, const FilterPlan& plan, const cv::Rect& roi, cv::Mat& dst) {
+    switch (plan.strategy) {
+    case Strategy::BoxComplement:
+        filterRegionBoxComplement(src, plan, roi, dst);
+        break;
+    case Strategy::Separable:
+        filterRegionSeparable(src, plan, roi, dst);
+        break;
+    case Strategy::FFT:
+        filterRegionFFT(src, plan, roi, dst);
+        break;
+    case Strategy::Direct:
+    default:
+        if (plan.simdLevel != SimdLevel::None) {
+            filterRegionDirectSimd(src, plan, roi, dst);
+        }
+        else {
+            filterRegionDirect(src, plan.kernel, roi, dst);
+        }
+        break;
+    }
+}
+
+bool parseOutputMode(const std::string& text, FilterPlan& plan) {
+    size_t comma = text.find(',');
+    std::string mode = text.substr(0, comma);
+    float alpha = 1.0f;
+    if (comma != std::string::npos) {
+        char* end = nullptr;
+        alpha = std::strtof(text.c_str() + comma + 1, &end);
+        if (end == text.c_str() + comma + 1 || *end != '\0' || mode != "sharpen") {
+            return false;
+        }
+    }
+
+    if (mode == "response") {
+        plan.output = OutputMode::Response;
+    }
+    else if (mode == "saturate") {
+        plan.output = OutputMode::Saturate;
+    }
+    else if (mode == "sharpen") {
+        plan.output = OutputMode::Sharpen;
+    }
+    else {
+        return false;
+    }
+    plan.sharpenAlpha = alpha;
+    return true;
+}
+
+int outputType(const FilterPlan& plan, int channels) {
+    return plan.output == OutputMode::Response ? CV_32FC(channels) : CV_8UC(channels);
+}
+
+void filterRegion(const SourceBand& src, const FilterPlan& plan, const cv::Rect& roi, cv::Mat& dst) {
+    // 16-bit sums are finished by the row kernel loop itself
+    if (plan.strategy == Strategy::Direct && plan.simdLevel != SimdLevel::None && plan.shortAccumulator) {
+        filterRegionDirectSimd(src, plan, roi, dst);
+        return;
+    }
+    if (plan.output == OutputMode::Response) {
+        filterResponse(src, plan, roi, dst);
+        return;
+    }
+
+    // Bands of rows small enough for their response to stay in cache until
+    // it is finished, tall enough that the per-call setup of the strategies
+    // does not matter. They start at multiples of rowAlignment(), so every
+    // band gets exactly its rows of the whole response.
+    const int cn = src.rows.channels();
+    const int alignment = rowAlignment(plan);
+    int bandRows = std::max(int(FINISH_BYTES / (size_t(std::max(roi.width, 1)) * cn * sizeof(float))),
+        4 * plan.kernel.rows());
+    bandRows = (bandRows + alignment - 1) / alignment * alignment;
+
+    dst.create(roi.size(), CV_8UC(cn));
+    const bool sharpen = plan.output == OutputMode::Sharpen;
+    cv::Mat response;
+    for (int y = 0; y < roi.height; y += bandRows) {
+        int height = std::min(bandRows, roi.height - y);
+        filterResponse(src, plan, cv::Rect(roi.x, roi.y + y, roi.width, height), response);
+
+        for (int i = 0; i < height; ++i) {
+            const float* r = response.ptr<float>(i);
+            uchar* out = dst.ptr<uchar>(y + i);
+            if (sharpen) {
+                const uchar* pixel = src.rows.ptr<uchar>(roi.y + y + i - src.firstRow) + roi.x * cn;
+                for (int x = 0; x < roi.width * cn; ++x) {
+                    out[x] = cv::saturate_cast<uchar>(r[x] + plan.sharpenAlpha * pixel[x]);
+                }
+            }
+            else {
+                for (int x = 0; x < roi.width * cn; ++x) {
+                    out[x] = cv::saturate_cast<uchar>(r[x]);
+                }
+            }
+        }
+    }
+}
+
+int rowAlignment(const FilterPlan& plan) {
+    return plan.strategy == Strategy::FFT ? plan.dftSize - plan.kernel.rows() + 1 : 1;
+}
+
+void filterRegionDirect(const SourceBand& src, const Kernel& kernel, const cv::Rect& roi, cv::Mat& dst) {
+    const int cn = src.rows.channels();
+    const int ry = kernel.radiusY();
+    const int rx = kernel.radiusX();
+    CV_Assert(src.rows.depth() == CV_8U && cn <= 4);
+    CV_Assert(std::max(roi.y - ry, 0) >= src.firstRow &&
+        std::min(roi.y + roi.height + ry, src.imageRows) <= src.firstRow + src.rows.rows);
+
+    dst.create(roi.size(), CV_32FC(cn));
+
+    // Taps that fall outside the image read zero and add nothing, so each
+    // pixel only visits the kernel rows and columns over the image. Skipping
+    // them leaves every sum bit-identical to a zero padded copy.
+    for (int i = 0; i < roi.height; ++i) {
+        int y = roi.y + i;
+        int mBegin = std::max(ry - y, 0), mEnd = std::min(src.imageRows - y + ry, kernel.rows());
+        float* out = dst.ptr<float>(i);
+        for (int j = 0; j < roi.width; ++j) {
+            int x = roi.x + j;
+            int nBegin = std::max(rx - x, 0), nEnd = std::min(src.rows.cols - x + rx, kernel.cols());
+
+            // Compute the sum of element-wise products between the kernel and the corresponding section of the image
+            float sum[4] = { 0, 0, 0, 0 };
+            for (int m = mBegin; m < mEnd; ++m) {
+                const uchar* pixel = src.rows.ptr<uchar>(y + m - ry - src.firstRow) + (x - rx + nBegin) * cn;
+                const float* k = kernel.taps.ptr<float>(m);
+                for (int n = nBegin; n < nEnd; ++n, pixel += cn) {
+                    for (int c = 0; c < cn; ++c) {
+                        sum[c] += pixel[c] * k[n];
+                    }
+                }
+            }
+            // Store the result in the output image
+            for (int c = 0; c < cn; ++c) {
+                out[j * cn + c] = sum[c];
+            }
+        }
+    }
+}
+
+}
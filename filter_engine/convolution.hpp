@@ -0,0 +1,166 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <ostream>
+#include <string>
+
+#include "kernel.hpp"
+
+namespace hpf {
+
+// A horizontal band of consecutive, full-width image rows.
+// Rows outside [0, imageRows) read as zero, so a band only has to hold the
+// rows of the image a caller actually needs.
+struct SourceBand {
+    cv::Mat rows;       // CV_8UC(n) rows of the image, n <= 4
+    int firstRow = 0;   // Image row index of rows.row(0)
+    int imageRows = 0;  // Height of the whole image
+};
+
+// How a kernel is evaluated.
+enum class Strategy {
+    Direct,         // Full rows x cols multiply-adds per pixel
+    BoxComplement,  // Constant taps around a different center, O(1) per pixel
+    Separable,      // Sum of rank-1 column/row passes, O(rank * (rows + cols)) per pixel
+    FFT             // Overlap-save tiles multiplied with a cached kernel spectrum
+};
+
+const char* strategyName(Strategy strategy);
+
+// Vector instruction sets the direct strategy can use, in increasing order.
+enum class SimdLevel {
+    None,
+    SSE2,
+    AVX2,
+    AVX512
+};
+
+const char* simdLevelName(SimdLevel level);
+
+// Widest instruction set this CPU and build support.
+SimdLevel detectSimdLevel();
+
+// What filterRegion() stores per pixel. The 8-bit modes finish each band of
+// rows while its response is still in cache, so no full-size float response
+// is ever written. Rounding and saturation match cv::Mat::convertTo().
+enum class OutputMode {
+    Response,  // The CV_32FC(n) response
+    Saturate,  // The response saturated to CV_8UC(n)
+    Sharpen    // The response plus sharpenAlpha times the source pixel, saturated to CV_8UC(n)
+};
+
+struct PlanOptions {
+    // Largest relative Frobenius error accepted when a kernel is replaced by
+    // a low-rank approximation. Zero only accepts exact decompositions.
+    double rankTolerance = 1e-6;
+
+    // Image size the plan will mostly be used on, for the strategy cost
+    // estimate. Left empty a large image is assumed.
+    cv::Size imageSize;
+
+    // Consider the FFT strategy for large kernels
+    bool allowFFT = true;
+
+    // Cap on the instruction set of the direct strategy; None forces the
+    // scalar loops
+    SimdLevel maxSimdLevel = SimdLevel::AVX512;
+};
+
+// A kernel together with everything precomputed to evaluate it.
+// Built once per kernel and shared by every thread and rank.
+struct FilterPlan {
+    Kernel kernel;
+    Strategy strategy = Strategy::Direct;
+
+    // Direct: vector instruction set used, and whether the taps are small
+    // integers that the int16 multiply-add path evaluates exactly
+    SimdLevel simdLevel = SimdLevel::None;
+    bool integerTaps = false;
+
+    // Direct with integer taps: the response of any 8-bit image fits int16,
+    // so the row kernels accumulate in 16-bit lanes and filterRegion()
+    // finishes their sums without a float response
+    bool shortAccumulator = false;
+
+    // Direct with SIMD: size of the compile-time unrolled row kernel (0 for
+    // the generic tap loop), and whether the taps are the StaticLaplacian
+    int unrolledSize = 0;
+    bool staticLaplacian = false;
+
+    // BoxComplement: response = boxWeight * box_sum + centerWeight * center
+    int boxWeight = 0;
+    int centerWeight = 0;
+
+    // Separable: row c of columnTaps (rank x rows) and rowTaps (rank x cols)
+    // form the c-th rank-1 term of the kernel
+    int rank = 0;
+    cv::Mat columnTaps;
+    cv::Mat rowTaps;
+
+    // FFT: dftSize x dftSize transforms, each producing a
+    // (dftSize - rows + 1) x (dftSize - cols + 1) output tile
+    int dftSize = 0;
+    cv::Mat kernelSpectrum;  // CV_32FC2 spectrum of the zero padded taps
+
+    // What is stored, set by the caller after makeFilterPlan()
+    OutputMode output = OutputMode::Response;
+    float sharpenAlpha = 1.0f;
+};
+
+// Pick the cheapest strategy for the kernel. BoxComplement is bit-identical to
+// Direct; Separable matches it within options.rankTolerance and FFT within
+// float rounding. Separable and FFT are weighed against Direct with the
+// calibrated cost model (cost_model.hpp).
+FilterPlan makeFilterPlan(const Kernel& kernel, const PlanOptions& options = PlanOptions());
+
+// Short human readable description of the chosen strategy, for logs.
+std::string describePlan(const FilterPlan& plan);
+
+// Parse "response", "saturate" or "sharpen", optionally followed by
+// ",alpha", into plan.output and plan.sharpenAlpha. Returns false if invalid.
+bool parseOutputMode(const std::string& text, FilterPlan& plan);
+
+// Type of the pixels filterRegion() stores for an image with channels
+// channels: CV_32FC(channels) for OutputMode::Response, CV_8UC(channels)
+// otherwise.
+int outputType(const FilterPlan& plan, int channels);
+
+// Compute the zero padded, same-size response over roi (image coordinates)
+// and store it as plan.output asks. Every image row within the kernel radius
+// of roi must be present in src. dst is (re)created as roi.size()
+// outputType(); passing a view of the right size and type writes straight
+// into the parent image.
+void filterRegion(const SourceBand& src, const FilterPlan& plan, const cv::Rect& roi, cv::Mat& dst);
+
+// Row granularity of bit-identical splits: filtering a region in bands whose
+// first rows are multiples of this (relative to the region) gives exactly the
+// response of a single filterRegion() call. FFT plans place their tiles from
+// the first row of the region, every other strategy computes rows on their own.
+int rowAlignment(const FilterPlan& plan);
+
+// Strategy implementations behind filterRegion()
+void filterRegionDirect(const SourceBand& src, const Kernel& kernel, const cv::Rect& roi, cv::Mat& dst);
+// Stores plan.output when plan.shortAccumulator is set, the float response otherwise
+void filterRegionDirectSimd(const SourceBand& src, const FilterPlan& plan, const cv::Rect& roi, cv::Mat& dst);
+void filterRegionBoxComplement(const SourceBand& src, const FilterPlan& plan, const cv::Rect& roi, cv::Mat& dst);
+void filterRegionSeparable(const SourceBand& src, const FilterPlan& plan, const cv::Rect& roi, cv::Mat& dst);
+void filterRegionFFT(const SourceBand& src, const FilterPlan& plan, const cv::Rect& roi, cv::Mat& dst);
+
+// Fill plan.columnTaps/rowTaps with the lowest-rank decomposition of
+// plan.kernel within tolerance. Returns false if the kernel has full rank.
+bool decomposeKernel(FilterPlan& plan, double tolerance);
+
+// Fill plan.dftSize/kernelSpectrum for plan.kernel.
+void prepareFFT(FilterPlan& plan);
+
+// Fill plan.simdLevel/integerTaps/shortAccumulator for plan.kernel, using at most maxLevel.
+void prepareDirect(FilterPlan& plan, SimdLevel maxLevel);
+
+// Compare every available SIMD level against the scalar direct loops over
+// kernel sizes 1 to 63, integer and fractional taps and ragged image widths.
+// Unrolled sizes are also compared through the generic tap loop, and
+// 16-bit sums, down to taps at the edge of their bound, through 32-bit ones.
+// Mismatches are written to log; returns their number.
+int verifySimdKernels(std::ostream& log);
+
+}
@@ -0,0 +1,92 @@
+#include "cost_model.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+
+namespace hpf {
+
+// Calibration workload, big enough to get past timer resolution
+static const int CALIBRATION_SIZE = 128;
+static const int CALIBRATION_KERNEL = 15;
+static const int CALIBRATION_RUNS = 3;
+
+// Best of a few runs of one strategy over the calibration image, in seconds
+static double timeStrategy(const FilterPlan& plan, const cv::Mat& image) {
+    SourceBand src{ image, 0, image.rows };
+    cv::Rect roi(0, 0, image.cols, image.rows);
+    cv::Mat response;
+    double best = 1e30;
+    for (int run = 0; run < CALIBRATION_RUNS; ++run) {
+        auto start = std::chrono::steady_clock::now();
+        filterRegion(src, plan, roi, response);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+CostModel calibrateCostModel() {
+    cv::Mat image(CALIBRATION_SIZE, CALIBRATION_SIZE, CV_8UC1);
+    cv::randu(image, cv::Scalar(0), cv::Scalar(256));
+    cv::Size size = image.size();
+
+    // Random taps, evaluated the same way by every strategy
+    cv::Mat taps(CALIBRATION_KERNEL, CALIBRATION_KERNEL, CV_32F);
+    cv::randu(taps, cv::Scalar(-8), cv::Scalar(8));
+
+    FilterPlan plan;
+    plan.kernel = makeKernel(taps);
+    prepareDirect(plan, SimdLevel::AVX512);
+
+    // Unit costs: divide the measured time by the work the estimate counts
+    CostModel model;
+    plan.strategy = Strategy::Direct;
+    model.directTap = timeStrategy(plan, image) / estimateCost(CostModel(), plan, Strategy::Direct, size);
+
+    plan.strategy = Strategy::Separable;
+    plan.rank = 1;
+    plan.columnTaps = taps.row(0).clone();
+    plan.rowTaps = taps.row(1).clone();
+    model.separableTap = timeStrategy(plan, image) / estimateCost(CostModel(), plan, Strategy::Separable, size);
+
+    plan.strategy = Strategy::FFT;
+    prepareFFT(plan);
+    model.fftPoint = timeStrategy(plan, image) / estimateCost(CostModel(), plan, Strategy::FFT, size);
+
+    model.calibrated = true;
+    return model;
+}
+
+const CostModel& costModel() {
+    static CostModel model;
+    static std::once_flag calibrated;
+    std::call_once(calibrated, [] { model = calibrateCostModel(); });
+    return model;
+}
+
+double estimateCost(const CostModel& model, const FilterPlan& plan, Strategy strategy, cv::Size imageSize) {
+    double pixels = double(imageSize.width) * imageSize.height;
+    const Kernel& kernel = plan.kernel;
+
+    switch (strategy) {
+    case Strategy::Separable:
+        return model.separableTap * pixels * plan.rank * (kernel.rows() + kernel.cols());
+    case Strategy::FFT: {
+        // Every tile costs a full transform, however little of it is used
+        double n = plan.dftSize;
+        int tileRows = plan.dftSize - kernel.rows() + 1;
+        int tileCols = plan.dftSize - kernel.cols() + 1;
+        double tiles = double((imageSize.height + tileRows - 1) / tileRows) * ((imageSize.width + tileCols - 1) / tileCols);
+        return model.fftPoint * tiles * n * n * std::log2(n * n);
+    }
+    case Strategy::BoxComplement:
+        return 0;
+    case Strategy::Direct:
+    default:
+        return model.directTap * pixels * kernel.rows() * kernel.cols();
+    }
+}
+
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include "convolution.hpp"
+
+namespace hpf {
+
+// Seconds per unit of work of each strategy on this machine, used by
+// makeFilterPlan() to pick between Direct, Separable and FFT.
+struct CostModel {
+    double directTap = 1;     // One 2-D tap for one pixel channel
+    double separableTap = 1;  // One 1-D tap for one pixel channel
+    double fftPoint = 1;      // One N*N*log2(N*N) unit of a forward plus inverse transform
+    bool calibrated = false;
+};
+
+// Time each strategy on a small synthetic image. Takes a few milliseconds.
+CostModel calibrateCostModel();
+
+// Cost model of this process, calibrated on first use.
+const CostModel& costModel();
+
+// Estimated single-threaded time for one channel of an image of the given size.
+double estimateCost(const CostModel& model, const FilterPlan& plan, Strategy strategy, cv::Size imageSize);
+
+}
@@ -0,0 +1,106 @@
+#include "convolution.hpp"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace hpf {
+
+// Transform size relative to the kernel: larger tiles waste less of each
+// transform on the kernel overlap
+static const int FFT_SIZE_FACTOR = 4;
+static const int MIN_FFT_SIZE = 64;
+
+void prepareFFT(FilterPlan& plan) {
+    const Kernel& kernel = plan.kernel;
+    plan.dftSize = cv::getOptimalDFTSize(std::max(FFT_SIZE_FACTOR * std::max(kernel.rows(), kernel.cols()), MIN_FFT_SIZE));
+
+    // Spectra computed so far, keyed by transform size and taps: every plan
+    // of a kernel and every rank receiving it shares one
+    static std::mutex spectraMutex;
+    static std::map<std::string, cv::Mat> spectra;
+    std::string key = std::to_string(plan.dftSize) + " " + std::to_string(kernel.rows()) + "x" +
+        std::to_string(kernel.cols()) + " ";
+    for (int m = 0; m < kernel.rows(); ++m) {
+        key.append(kernel.taps.ptr<char>(m), kernel.cols() * sizeof(float));
+    }
+    {
+        std::lock_guard<std::mutex> lock(spectraMutex);
+        auto found = spectra.find(key);
+        if (found != spectra.end()) {
+            plan.kernelSpectrum = found->second;
+            return;
+        }
+    }
+
+    // Spectrum of the taps in the top-left corner of an otherwise zero tile
+    cv::Mat padded(plan.dftSize, plan.dftSize, CV_32F, cv::Scalar(0));
+    kernel.taps.copyTo(padded(cv::Rect(0, 0, kernel.cols(), kernel.rows())));
+    cv::Mat spectrum;
+    cv::dft(padded, spectrum, cv::DFT_COMPLEX_OUTPUT, kernel.rows());
+    std::lock_guard<std::mutex> lock(spectraMutex);
+    plan.kernelSpectrum = spectra.emplace(key, spectrum).first->second;
+}
+
+void filterRegionFFT(const SourceBand& src, const FilterPlan& plan, const cv::Rect& roi, cv::Mat& dst) {
+    const int cn = src.rows.channels();
+    const int ry = plan.kernel.radiusY();
+    const int rx = plan.kernel.radiusX();
+    CV_Assert(src.rows.depth() == CV_8U && cn <= 4);
+    CV_Assert(std::max(roi.y - ry, 0) >= src.firstRow &&
+        std::min(roi.y + roi.height + ry, src.imageRows) <= src.firstRow + src.rows.rows);
+
+    // Overlap-save: correlating an N x N input tile with the kernel leaves
+    // (N - rows + 1) x (N - cols + 1) outputs untouched by the circular wrap
+    const int N = plan.dftSize;
+    const int tileRows = N - plan.kernel.rows() + 1;
+    const int tileCols = N - plan.kernel.cols() + 1;
+
+    dst.create(roi.size(), CV_32FC(cn));
+
+    cv::Mat tile(N, N, CV_32F), spectrum, result;
+    for (int ty = 0; ty < roi.height; ty += tileRows) {
+        int outRows = std::min(tileRows, roi.height - ty);
+        int inRows = outRows + plan.kernel.rows() - 1;
+
+        // Input rows of this tile in image coordinates and the part inside the image
+        int y0 = roi.y + ty - ry;
+        int inY0 = std::max(y0, 0), inY1 = std::min(y0 + inRows, src.imageRows);
+
+        for (int tx = 0; tx < roi.width; tx += tileCols) {
+            int outCols = std::min(tileCols, roi.width - tx);
+            int inCols = outCols + plan.kernel.cols() - 1;
+            int x0 = roi.x + tx - rx;
+            int inX0 = std::max(x0, 0), inX1 = std::min(x0 + inCols, src.rows.cols);
+
+            for (int c = 0; c < cn; ++c) {
+                // Load one channel of the tile, zero outside the image
+                tile.setTo(cv::Scalar(0));
+                for (int y = inY0; y < inY1; ++y) {
+                    const uchar* in = src.rows.ptr<uchar>(y - src.firstRow);
+                    float* t = tile.ptr<float>(y - y0);
+                    for (int x = inX0; x < inX1; ++x) {
+                        t[x - x0] = in[x * cn + c];
+                    }
+                }
+
+                // Correlate with the kernel: multiply by the conjugate spectrum
+                cv::dft(tile, spectrum, cv::DFT_COMPLEX_OUTPUT, inRows);
+                cv::mulSpectrums(spectrum, plan.kernelSpectrum, spectrum, 0, true);
+                cv::dft(spectrum, result, cv::DFT_INVERSE | cv::DFT_SCALE | cv::DFT_REAL_OUTPUT, outRows);
+
+                // Store the valid part of the tile
+                for (int i = 0; i < outRows; ++i) {
+                    const float* r = result.ptr<float>(i);
+                    float* out = dst.ptr<float>(ty + i) + tx * cn;
+                    for (int j = 0; j < outCols; ++j) {
+                        out[j * cn + c] = r[j];
+                    }
+                }
+            }
+        }
+    }
+}
+
+}
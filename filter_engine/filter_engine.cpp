@@ -0,0 +1,180 @@
+#include "filter_engine.hpp"
+
+#include <cstdlib>
+#include <iostream>
+
+namespace hpf {
+
+cv::Mat convolve(const cv::Mat& image, const Kernel& kernel, const ExecutionPolicy& policy) {
+    PlanOptions options;
+    options.imageSize = image.size();
+    return convolve(image, cachedFilterPlan(kernel, options), policy);
+}
+
+bool isSupportedImage(const cv::Mat& image) {
+    if (image.empty()) {
+        std::cerr << "Error: Empty image or kernel." << std::endl;
+        return false;
+    }
+    if (image.depth() != CV_8U || image.channels() > 4) {
+        std::cerr << "Error: Only 8-bit images with up to 4 channels are supported." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+cv::Mat convolve(const cv::Mat& image, const FilterPlan& plan, const ExecutionPolicy& policy) {
+    // Check that there is something to filter
+    if (plan.kernel.empty()) {
+        std::cerr << "Error: Empty image or kernel." << std::endl;
+        return cv::Mat();
+    }
+
+    // With MPI only the root holds the image, it checks it for every rank
+    if (policy.backend == Backend::MPI || policy.backend == Backend::Hybrid) {
+        return convolveMPI(image, plan, policy);
+    }
+    if (!isSupportedImage(image)) {
+        return cv::Mat();
+    }
+
+    switch (policy.backend) {
+    case Backend::OpenMP:
+        return convolveOpenMP(image, plan, policy);
+    case Backend::Sequential:
+    default:
+        return convolveSequential(image, plan);
+    }
+}
+
+cv::Mat convolveSequential(const cv::Mat& image, const FilterPlan& plan) {
+    TraceScope phase("filter", "compute", image.total() * image.elemSize());
+    cv::Mat response;
+    filterRegion(SourceBand{ image, 0, image.rows }, plan, cv::Rect(0, 0, image.cols, image.rows), response);
+    return response;
+}
+
+bool parseSchedule(const std::string& text, ExecutionPolicy& policy) {
+    size_t comma = text.find(',');
+    std::string kind = text.substr(0, comma);
+    int chunk = 0;
+    if (comma != std::string::npos) {
+        char* end = nullptr;
+        long value = std::strtol(text.c_str() + comma + 1, &end, 10);
+        if (end == text.c_str() + comma + 1 || *end != '\0' || value <= 0 || kind == "runtime") {
+            return false;
+        }
+        chunk = int(value);
+    }
+
+    if (kind == "static") {
+        policy.schedule = Schedule::Static;
+    }
+    else if (kind == "dynamic") {
+        policy.schedule = Schedule::Dynamic;
+    }
+    else if (kind == "guided") {
+        policy.schedule = Schedule::Guided;
+    }
+    else if (kind == "runtime") {
+        policy.schedule = Schedule::Runtime;
+    }
+    else {
+        return false;
+    }
+    policy.chunk = chunk;
+    return true;
+}
+
+bool parseAffinity(const std::string& text, ExecutionPolicy& policy) {
+    if (text == "default") {
+        policy.affinity = Affinity::Default;
+    }
+    else if (text == "close") {
+        policy.affinity = Affinity::Close;
+    }
+    else if (text == "spread") {
+        policy.affinity = Affinity::Spread;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+bool parseBackend(const std::string& text, ExecutionPolicy& policy) {
+    for (Backend backend : { Backend::Sequential, Backend::OpenMP, Backend::MPI, Backend::Hybrid }) {
+        if (text == backendName(backend)) {
+            policy.backend = backend;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* backendName(Backend backend) {
+    switch (backend) {
+    case Backend::OpenMP:
+        return "openmp";
+    case Backend::MPI:
+        return "mpi";
+    case Backend::Hybrid:
+        return "hybrid";
+    case Backend::Sequential:
+    default:
+        return "sequential";
+    }
+}
+
+bool parseExecutionArgs(int argc, char** argv, ExecutionPolicy& policy) {
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--first-touch") {
+            policy.firstTouch = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Error: Missing value for " << option << "." << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+        bool valid = true;
+        if (option == "--threads") {
+            policy.threads = std::atoi(value.c_str());
+            valid = policy.threads > 0;
+        }
+        else if (option == "--schedule") {
+            valid = parseSchedule(value, policy);
+        }
+        else if (option == "--bind") {
+            valid = parseAffinity(value, policy);
+        }
+        else if (option == "--distribution") {
+            valid = value == "static" || value == "dynamic";
+            policy.distribution = value == "dynamic" ? Distribution::Dynamic : Distribution::Static;
+        }
+        else if (option == "--block-rows") {
+            policy.blockRows = std::atoi(value.c_str());
+            valid = policy.blockRows > 0;
+        }
+        else if (option == "--plan-cache") {
+            valid = setPlanCacheDirectory(value);
+        }
+        else if (option == "--trace") {
+            policy.tracePath = value;
+            valid = !value.empty();
+            setTracing(valid);
+        }
+        else {
+            std::cerr << "Error: Unknown option " << option << "." << std::endl;
+            return false;
+        }
+        if (!valid) {
+            std::cerr << "Error: Invalid value " << value << " for " << option << "." << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+}
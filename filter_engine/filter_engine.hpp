@@ -0,0 +1,149 @@
+#pragma once
+
+#include <mpi.h>
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+
+#include "convolution.hpp"
+#include "kernel.hpp"
+#include "plan_cache.hpp"
+#include "trace.hpp"
+
+namespace hpf {
+
+// Where convolve() runs.
+enum class Backend {
+    Sequential,
+    OpenMP,
+    MPI,
+    Hybrid  // MPI across ranks, OpenMP inside each rank's part; needs MPI_THREAD_FUNNELED
+};
+
+// Loop schedule of the OpenMP backend. Runtime leaves it to OMP_SCHEDULE.
+enum class Schedule {
+    Static,
+    Dynamic,
+    Guided,
+    Runtime
+};
+
+// Thread placement of the OpenMP backend. Default leaves it to OMP_PROC_BIND
+// and OMP_PLACES; Close packs the threads onto neighbouring places, Spread
+// distributes them across sockets.
+enum class Affinity {
+    Default,
+    Close,
+    Spread
+};
+
+// How the MPI backend splits the image. Static gives every rank one balanced
+// strip; Dynamic hands out row blocks on demand, so faster ranks take more.
+enum class Distribution {
+    Static,
+    Dynamic
+};
+
+// Work and waiting per rank of a dynamic MPI distribution
+struct SchedulerStats {
+    std::vector<int> blocks;
+    std::vector<double> busySeconds;
+    std::vector<double> idleSeconds;
+};
+
+struct ExecutionPolicy {
+    Backend backend = Backend::Sequential;
+    MPI_Comm comm = MPI_COMM_WORLD;  // Used by Backend::MPI and Hybrid only
+
+    // Backend::MPI and Hybrid: strips or on-demand blocks of blockRows rows (0 picks a
+    // height from the image and rank count). With Dynamic, a non-null stats
+    // is filled on rank 0.
+    Distribution distribution = Distribution::Static;
+    int blockRows = 0;
+    SchedulerStats* stats = nullptr;
+
+    // Backend::OpenMP and Hybrid: hand out cache-sized 2-D tiles instead of full-width
+    // row blocks. An empty tileSize is tuned from the detected cache sizes.
+    // Box-complement and FFT plans always use row blocks.
+    bool tiled = false;
+    cv::Size tileSize;
+
+    // Backend::OpenMP and Hybrid: thread count (0 for the OpenMP default), loop
+    // schedule with its chunk size in tiles (0 for the schedule's default)
+    // and thread placement
+    int threads = 0;
+    Schedule schedule = Schedule::Static;
+    int chunk = 0;
+    Affinity affinity = Affinity::Default;
+
+    // Backend::OpenMP and Hybrid: clear the response in the threads that later
+    // filter each tile, so with a static schedule its pages are placed on the
+    // NUMA node of the thread writing them. The image is read where it is.
+    bool firstTouch = false;
+
+    // Every backend: when not empty, the binary writes the phase timeline of
+    // the run there with writeTrace() before it exits
+    std::string tracePath;
+};
+
+// Parse "static", "dynamic" or "guided", optionally followed by ",chunk", or
+// "runtime" into policy.schedule and policy.chunk. Returns false if invalid.
+bool parseSchedule(const std::string& text, ExecutionPolicy& policy);
+
+// Parse "default", "close" or "spread" into policy.affinity. Returns false if invalid.
+bool parseAffinity(const std::string& text, ExecutionPolicy& policy);
+
+// Parse "sequential", "openmp", "mpi" or "hybrid" into policy.backend. Returns false if invalid.
+bool parseBackend(const std::string& text, ExecutionPolicy& policy);
+
+// Lower-case name of backend as parseBackend() takes it
+const char* backendName(Backend backend);
+
+// Parse the execution options of the command line into policy:
+//   OpenMP: --threads N  --schedule static|dynamic|guided[,chunk]|runtime
+//           --bind default|close|spread  --first-touch
+//   MPI:    --distribution static|dynamic  --block-rows N
+//   All:    --trace FILE (also turns tracing on)  --plan-cache DIR
+// Prints the problem and returns false on an unknown or invalid option.
+bool parseExecutionArgs(int argc, char** argv, ExecutionPolicy& policy);
+
+// Single convolution entry point for every binary.
+// Returns the zero padded, same-size CV_32FC(n) response of a CV_8UC(n)
+// image, or the 8-bit pixels the OutputMode of the plan finishes it into.
+// With Backend::MPI and Hybrid every rank of policy.comm must call it with
+// the same kernel, but only rank 0 needs the image: it scatters the strips
+// and the other ranks may pass an empty matrix. The full response is
+// returned on rank 0 and an empty matrix on the other ranks. The plan comes
+// from cachedFilterPlan(), so it is built once per kernel and image size.
+cv::Mat convolve(const cv::Mat& image, const Kernel& kernel, const ExecutionPolicy& policy);
+
+// Same as above with a plan built once by makeFilterPlan(), for callers that
+// filter many images with the same kernel.
+cv::Mat convolve(const cv::Mat& image, const FilterPlan& plan, const ExecutionPolicy& policy);
+
+// Backend implementations behind convolve()
+cv::Mat convolveSequential(const cv::Mat& image, const FilterPlan& plan);
+cv::Mat convolveOpenMP(const cv::Mat& image, const FilterPlan& plan, const ExecutionPolicy& policy);
+cv::Mat convolveMPI(const cv::Mat& image, const FilterPlan& plan, const ExecutionPolicy& policy);
+
+// filterRegion() spread over the OpenMP threads as configured by policy
+void filterRegionOpenMP(const SourceBand& src, const FilterPlan& plan, const cv::Rect& roi, cv::Mat& dst,
+    const ExecutionPolicy& policy);
+
+// Print why and return false unless image is a non-empty CV_8UC(n) image
+// with n <= 4.
+bool isSupportedImage(const cv::Mat& image);
+
+// One line per rank with its blocks, busy and idle time, for logs.
+std::string describeStats(const SchedulerStats& stats);
+
+// Send the kernel held by root to every rank of comm in two messages.
+void broadcastKernel(Kernel& kernel, int root, MPI_Comm comm);
+
+// Send the plan built by root to every rank of comm, so all ranks evaluate
+// the kernel the same way whatever their own cost model or image would pick.
+// Ranks below the instruction set of root keep their best one. Two messages
+// whatever the strategy: the fields, then every float of the plan.
+void broadcastPlan(FilterPlan& plan, int root, MPI_Comm comm);
+
+}
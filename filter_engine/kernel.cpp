@@ -0,0 +1,51 @@
+#include "kernel.hpp"
+
+#include <iostream>
+
+#include "static_kernels.hpp"
+
+namespace hpf {
+
+Kernel makeKernel(const cv::Mat& taps) {
+    // Check if the matrix is valid
+    if (taps.empty() || taps.channels() != 1 || taps.rows % 2 == 0 || taps.cols % 2 == 0) {
+        std::cerr << "Invalid kernel. It should be a single channel matrix with odd dimensions." << std::endl;
+        return Kernel();
+    }
+
+    Kernel kernel;
+    taps.convertTo(kernel.taps, CV_32F);
+    return kernel;
+}
+
+Kernel generateHighPassKernel(int size) {
+    // Check if size is valid
+    if (size % 2 == 0 || size < 3) {
+        std::cerr << "Invalid kernel size. It should be an odd number >= 3." << std::endl;
+        return Kernel();
+    }
+
+    // Create the kernel matrix
+    Kernel kernel;
+    kernel.taps = cv::Mat(size, size, CV_32F, cv::Scalar(-1));
+
+    // Set the center value for high pass filtering
+    int center = size / 2;
+    kernel.taps.at<float>(center, center) = float(size * size - 1);
+
+    return kernel;
+}
+
+Kernel laplacianKernel() {
+    // Same taps the SIMD path specializes on
+    Kernel kernel;
+    kernel.taps = cv::Mat(StaticLaplacian::SIZE, StaticLaplacian::SIZE, CV_32F);
+    for (int m = 0; m < StaticLaplacian::SIZE; ++m) {
+        for (int n = 0; n < StaticLaplacian::SIZE; ++n) {
+            kernel.taps.at<float>(m, n) = float(StaticLaplacian::tap(m, n));
+        }
+    }
+    return kernel;
+}
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+namespace hpf {
+
+// Convolution kernel shared by every backend.
+// Taps are always stored as CV_32F with an odd number of rows and columns,
+// the anchor is the center tap.
+struct Kernel {
+    cv::Mat taps;
+
+    bool empty() const { return taps.empty(); }
+    int rows() const { return taps.rows; }
+    int cols() const { return taps.cols; }
+    int radiusY() const { return taps.rows / 2; }
+    int radiusX() const { return taps.cols / 2; }
+};
+
+// Build a kernel from any single channel matrix with odd dimensions.
+// Returns an empty kernel if the matrix is not usable.
+Kernel makeKernel(const cv::Mat& taps);
+
+// size x size kernel with (size * size - 1) at the center and -1 everywhere else.
+Kernel generateHighPassKernel(int size);
+
+// 3x3 Laplacian used by the static kernel builds.
+Kernel laplacianKernel();
+
+}
@@ -0,0 +1,208 @@
+#include "mapped_io.hpp"
+#include "streaming.hpp"
+#include "strips.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace hpf {
+
+// Granularity of map offsets
+static size_t mapGranularity() {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwAllocationGranularity;
+#else
+    return size_t(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+bool MappedImage::open(const std::string& path, bool forWriting, int firstRow, int rowCount) {
+    close();
+    NetpbmReader header;
+    if (!header.open(path)) {
+        return false;
+    }
+    imageSize = header.size();
+    imageType = header.type();
+    if (rowCount < 0) {
+        rowCount = imageSize.height - firstRow;
+    }
+    if (firstRow < 0 || rowCount < 0 || firstRow + rowCount > imageSize.height) {
+        std::cerr << "Error: Rows " << firstRow << " to " << firstRow + rowCount << " are outside " << path << "."
+            << std::endl;
+        return false;
+    }
+    first = firstRow;
+    writable = forWriting;
+
+    // Samples of the rows, which the file must hold in full
+    size_t rowBytes = size_t(imageSize.width) * CV_ELEM_SIZE(imageType);
+    size_t begin = size_t(header.dataOffset()) + size_t(firstRow) * rowBytes;
+    size_t bytes = size_t(rowCount) * rowBytes;
+    std::error_code error;
+    uintmax_t fileBytes = std::filesystem::file_size(path, error);
+    if (error || fileBytes < begin + bytes) {
+        std::cerr << "Error: " << path << " is shorter than its header says." << std::endl;
+        return false;
+    }
+    if (bytes == 0) {
+        view = cv::Mat(0, imageSize.width, imageType);
+        return true;
+    }
+
+    // Maps start at a multiple of the granularity before the first row
+    size_t start = begin / mapGranularity() * mapGranularity();
+    length = begin + bytes - start;
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    HANDLE mapping = file == INVALID_HANDLE_VALUE ? nullptr :
+        CreateFileMappingA(file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+    if (mapping) {
+        base = MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, DWORD(uint64_t(start) >> 32),
+            DWORD(start & 0xffffffff), length);
+        CloseHandle(mapping);  // The view keeps the mapping alive
+    }
+    if (file != INVALID_HANDLE_VALUE) {
+        CloseHandle(file);
+    }
+#else
+    int file = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (file >= 0) {
+        base = mmap(nullptr, length, PROT_READ | (writable ? PROT_WRITE : 0), MAP_SHARED, file, off_t(start));
+        ::close(file);  // The map keeps the file open
+        if (base == MAP_FAILED) {
+            base = nullptr;
+        }
+    }
+#endif
+    if (!base) {
+        std::cerr << "Error: Could not map " << path << "." << std::endl;
+        return false;
+    }
+    view = cv::Mat(rowCount, imageSize.width, imageType, static_cast<uchar*>(base) + (begin - start));
+    return true;
+}
+
+void MappedImage::close() {
+    view.release();
+    if (!base) {
+        return;
+    }
+#if defined(_WIN32)
+    if (writable) {
+        FlushViewOfFile(base, 0);
+    }
+    UnmapViewOfFile(base);
+#else
+    if (writable) {
+        msync(base, length, MS_SYNC);
+    }
+    munmap(base, length);
+#endif
+    base = nullptr;
+}
+
+bool createNetpbmFile(const std::string& path, cv::Size size, int type) {
+    {
+        NetpbmWriter writer;
+        if (!writer.create(path, size, type)) {
+            return false;
+        }
+    }
+
+    // Extend it past the header, the new samples read as zero
+    NetpbmReader header;
+    if (!header.open(path)) {
+        return false;
+    }
+    std::error_code error;
+    std::filesystem::resize_file(path, uintmax_t(header.dataOffset()) + uintmax_t(size.area()) * CV_ELEM_SIZE(type),
+        error);
+    if (error) {
+        std::cerr << "Error: Could not size " << path << ": " << error.message() << "." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Filter the rows of strip straight into dst, which starts at strip.y
+static void filterInto(const SourceBand& src, const FilterPlan& plan, const Strip& strip, cv::Mat& dst,
+    const ExecutionPolicy& policy) {
+    cv::Rect roi(0, strip.y, dst.cols, strip.height);
+    // Includes the page faults that read the input and write the output
+    TraceScope phase("filter", "compute", strip.height * dst.step[0]);
+    if (policy.backend == Backend::OpenMP || policy.backend == Backend::Hybrid) {
+        filterRegionOpenMP(src, plan, roi, dst, policy);
+    }
+    else {
+        filterRegion(src, plan, roi, dst);
+    }
+}
+
+bool filterMapped(const std::string& input, const std::string& output, const FilterPlan& plan,
+    const ExecutionPolicy& policy) {
+    if (plan.kernel.empty()) {
+        std::cerr << "Error: Empty image or kernel." << std::endl;
+        return false;
+    }
+    const bool distributed = policy.backend == Backend::MPI || policy.backend == Backend::Hybrid;
+    MPI_Comm comm = policy.comm;
+    int rank = 0, size = 1;
+    if (distributed) {
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &size);
+    }
+
+    // Rank 0 creates the output at its final size before any rank maps it
+    NetpbmReader header;
+    int ok = 1;
+    if (rank == 0) {
+        ok = header.open(input) && createNetpbmFile(output, header.size(), header.type());
+    }
+    if (size > 1) {
+        MPI_Bcast(&ok, 1, MPI_INT, 0, comm);
+    }
+    if (!ok) {
+        return false;
+    }
+
+    // Every rank maps its strip of the output and the input rows it reads
+    ok = rank == 0 || header.open(input);
+    if (ok) {
+        const int rows = header.size().height;
+        Strip strip = partStrip(rank, size, rows, rowAlignment(plan));
+        Strip window = haloStrip(strip, plan.kernel.radiusY(), rows);
+        MappedImage source, target;
+        ok = strip.height == 0 ||
+            (source.open(input, false, window.y, window.height) && target.open(output, true, strip.y, strip.height));
+        if (ok && strip.height > 0) {
+            // The filter saturates into the mapped rows itself, unless the caller asked it to sharpen
+            FilterPlan finishing = plan;
+            if (finishing.output == OutputMode::Response) {
+                finishing.output = OutputMode::Saturate;
+            }
+            cv::Mat dst = target.rows();
+            filterInto(SourceBand{ source.rows(), window.y, rows }, finishing, strip, dst, policy);
+        }
+    }
+
+    if (size > 1) {
+        MPI_Allreduce(MPI_IN_PLACE, &ok, 1, MPI_INT, MPI_MIN, comm);
+    }
+    return ok != 0;
+}
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+
+#include "filter_engine.hpp"
+
+namespace hpf {
+
+// Rows of a binary Netpbm image (P5 gray or P6 color, 8-bit samples) mapped
+// straight from its file, so they are read and written without decoding or
+// copying. Only the pages holding the requested rows are mapped.
+class MappedImage {
+public:
+    MappedImage() = default;
+    MappedImage(const MappedImage&) = delete;
+    MappedImage& operator=(const MappedImage&) = delete;
+    ~MappedImage() { close(); }
+
+    // Map rows [firstRow, firstRow + rowCount) of path, or every row from
+    // firstRow on with a negative rowCount. Writes to a map opened forWriting
+    // reach the file. Prints the problem and returns false if path is no such
+    // image.
+    bool open(const std::string& path, bool forWriting, int firstRow = 0, int rowCount = -1);
+
+    // Flush a writable map to the file and unmap
+    void close();
+
+    cv::Size size() const { return imageSize; }  // Of the whole image
+    int type() const { return imageType; }
+    int firstRow() const { return first; }
+
+    // The mapped rows, a view into the file valid until close()
+    cv::Mat rows() const { return view; }
+
+private:
+    cv::Size imageSize;
+    int imageType = 0;
+    int first = 0;
+    cv::Mat view;
+    void* base = nullptr;
+    size_t length = 0;
+    bool writable = false;
+};
+
+// Create path as a Netpbm image of size and type (CV_8UC1 or CV_8UC3),
+// sized up front with every sample zero. Prints the problem and returns false
+// on failure.
+bool createNetpbmFile(const std::string& path, cv::Size size, int type);
+
+// Filter the Netpbm image input into output, created at its final size here,
+// sharpened if plan.output asks for it and saturated to 8 bits otherwise.
+// The filter reads the mapped input in place and finishes each band of
+// response into the mapped output while it is still in cache. With
+// Backend::MPI and Hybrid every rank of policy.comm calls it with the same
+// arguments and plan and maps only its strip of output and the rows of input
+// it reads: nothing is decoded, scattered, exchanged or gathered, so the
+// ranks need both files on a shared file system. Strips start at multiples of
+// rowAlignment(), so the output matches the whole-image response exactly.
+// Returns false on every rank if any rank failed.
+bool filterMapped(const std::string& input, const std::string& output, const FilterPlan& plan,
+    const ExecutionPolicy& policy);
+
+}
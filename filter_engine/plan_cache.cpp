@@ -0,0 +1,196 @@
+#include "plan_cache.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+
+namespace hpf {
+
+// Start of every plan file, bumped whenever the layout below changes
+static const char PLAN_MAGIC[8] = { 'H', 'P', 'F', 'P', 'L', 'A', 'N', '1' };
+
+static std::mutex cacheMutex;
+static std::map<std::string, FilterPlan> plans;
+static std::string directory;
+
+template <class T>
+static void append(std::string& bytes, const T& value) {
+    bytes.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Everything makeFilterPlan() depends on, byte for byte
+static std::string planKey(const Kernel& kernel, const PlanOptions& options) {
+    std::string key;
+    append(key, int32_t(kernel.rows()));
+    append(key, int32_t(kernel.cols()));
+    for (int m = 0; m < kernel.rows(); ++m) {
+        key.append(kernel.taps.ptr<char>(m), kernel.cols() * sizeof(float));
+    }
+    append(key, options.rankTolerance);
+    append(key, int32_t(options.imageSize.width));
+    append(key, int32_t(options.imageSize.height));
+    append(key, int32_t(options.allowFFT));
+    append(key, int32_t(options.maxSimdLevel));
+    return key;
+}
+
+// 64-bit FNV-1a of the key, naming its file; the file holds the full key
+static std::string planFileName(const std::string& key) {
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : key) {
+        hash = (hash ^ uint8_t(c)) * 1099511628211ull;
+    }
+    char name[32];
+    std::snprintf(name, sizeof(name), "plan-%016llx.bin", static_cast<unsigned long long>(hash));
+    return name;
+}
+
+static void writeMat(std::ostream& out, const cv::Mat& mat) {
+    int32_t header[3] = { mat.rows, mat.cols, mat.type() };
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    for (int r = 0; r < mat.rows; ++r) {
+        out.write(mat.ptr<char>(r), std::streamsize(mat.cols * mat.elemSize()));
+    }
+}
+
+static bool readMat(std::istream& in, cv::Mat& mat) {
+    int32_t header[3];
+    if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] < 0 || header[1] < 0 ||
+        (header[2] != CV_32F && header[2] != CV_32FC2)) {
+        return false;
+    }
+    mat.release();
+    if (header[0] > 0 && header[1] > 0) {
+        mat.create(header[0], header[1], header[2]);
+        in.read(mat.ptr<char>(), std::streamsize(mat.total() * mat.elemSize()));
+    }
+    return bool(in);
+}
+
+// The plan stored under key, without the parts prepareDirect() derives for
+// this CPU
+static bool loadPlan(const std::string& path, const std::string& key, const Kernel& kernel,
+    const PlanOptions& options, FilterPlan& plan) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[sizeof(PLAN_MAGIC)];
+    uint32_t keyLength = 0;
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, PLAN_MAGIC, sizeof(magic)) != 0 ||
+        !in.read(reinterpret_cast<char*>(&keyLength), sizeof(keyLength)) || keyLength != key.size()) {
+        return false;
+    }
+    std::string stored(keyLength, '\0');
+    int32_t fields[5];
+    if (!in.read(&stored[0], keyLength) || stored != key ||
+        !in.read(reinterpret_cast<char*>(fields), sizeof(fields))) {
+        return false;
+    }
+
+    FilterPlan loaded;
+    loaded.kernel = kernel;
+    prepareDirect(loaded, options.maxSimdLevel);
+    loaded.strategy = Strategy(fields[0]);
+    loaded.boxWeight = fields[1];
+    loaded.centerWeight = fields[2];
+    loaded.rank = fields[3];
+    loaded.dftSize = fields[4];
+    if (!readMat(in, loaded.columnTaps) || !readMat(in, loaded.rowTaps) || !readMat(in, loaded.kernelSpectrum)) {
+        return false;
+    }
+
+    // A damaged file is rebuilt rather than trusted
+    bool valid = false;
+    switch (loaded.strategy) {
+    case Strategy::Direct:
+    case Strategy::BoxComplement:
+        valid = true;
+        break;
+    case Strategy::Separable:
+        valid = loaded.rank > 0 && loaded.columnTaps.type() == CV_32F && loaded.rowTaps.type() == CV_32F &&
+            loaded.columnTaps.size() == cv::Size(kernel.rows(), loaded.rank) &&
+            loaded.rowTaps.size() == cv::Size(kernel.cols(), loaded.rank);
+        break;
+    case Strategy::FFT:
+        valid = loaded.dftSize >= std::max(kernel.rows(), kernel.cols()) && loaded.kernelSpectrum.type() == CV_32FC2 &&
+            loaded.kernelSpectrum.size() == cv::Size(loaded.dftSize, loaded.dftSize);
+        break;
+    }
+    if (valid) {
+        plan = loaded;
+    }
+    return valid;
+}
+
+// Written under a unique name and renamed, so concurrent ranks and runs
+// never see a partial file
+static void storePlan(const std::string& path, const std::string& key, const FilterPlan& plan) {
+    std::string temporary = path + "." + std::to_string(std::random_device{}()) + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary);
+        uint32_t keyLength = uint32_t(key.size());
+        int32_t fields[5] = { int32_t(plan.strategy), plan.boxWeight, plan.centerWeight, plan.rank, plan.dftSize };
+        out.write(PLAN_MAGIC, sizeof(PLAN_MAGIC));
+        out.write(reinterpret_cast<const char*>(&keyLength), sizeof(keyLength));
+        out.write(key.data(), std::streamsize(key.size()));
+        out.write(reinterpret_cast<const char*>(fields), sizeof(fields));
+        writeMat(out, plan.columnTaps);
+        writeMat(out, plan.rowTaps);
+        writeMat(out, plan.kernelSpectrum);
+        if (!out) {
+            std::cerr << "Error: Could not write the plan cache file " << temporary << "." << std::endl;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+    }
+}
+
+FilterPlan cachedFilterPlan(const Kernel& kernel, const PlanOptions& options) {
+    if (kernel.empty()) {
+        return makeFilterPlan(kernel, options);
+    }
+    std::string key = planKey(kernel, options);
+    std::string folder;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto found = plans.find(key);
+        if (found != plans.end()) {
+            return found->second;
+        }
+        folder = directory;
+    }
+
+    // Built outside the lock; threads racing on the same key keep the first plan
+    FilterPlan plan;
+    std::string path = folder.empty() ? std::string() : (std::filesystem::path(folder) / planFileName(key)).string();
+    if (path.empty() || !loadPlan(path, key, kernel, options, plan)) {
+        plan = makeFilterPlan(kernel, options);
+        if (!path.empty()) {
+            storePlan(path, key, plan);
+        }
+    }
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return plans.emplace(key, plan).first->second;
+}
+
+bool setPlanCacheDirectory(const std::string& path) {
+    std::error_code error;
+    if (!path.empty() && !std::filesystem::is_directory(path, error) &&
+        !std::filesystem::create_directories(path, error)) {
+        std::cerr << "Error: Could not create the plan cache directory " << path << "." << std::endl;
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    directory = path;
+    return true;
+}
+
+}
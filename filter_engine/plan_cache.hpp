@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+
+#include "convolution.hpp"
+
+namespace hpf {
+
+// makeFilterPlan() built once per kernel and options in this process. The
+// key holds the taps and every PlanOptions field, image size included, so a
+// hit returns exactly the plan makeFilterPlan() would. Thread-safe; plans
+// share their precomputed matrices, so copies are cheap.
+FilterPlan cachedFilterPlan(const Kernel& kernel, const PlanOptions& options = PlanOptions());
+
+// Directory that plans missing in memory are looked up in and new plans are
+// written to, one file per plan, so later runs skip the decomposition,
+// spectrum and cost model calibration. Share it only between machines of the
+// same kind: the stored strategy was picked by this machine's cost model. An
+// empty path (the default) keeps the cache in memory. Returns false if the
+// directory cannot be created.
+bool setPlanCacheDirectory(const std::string& path);
+
+}
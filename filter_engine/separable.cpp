@@ -0,0 +1,106 @@
+#include "convolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace hpf {
+
+bool decomposeKernel(FilterPlan& plan, double tolerance) {
+    const Kernel& kernel = plan.kernel;
+
+    // Singular values come back in descending order
+    cv::Mat taps, w, u, vt;
+    kernel.taps.convertTo(taps, CV_64F);
+    cv::SVD::compute(taps, w, u, vt);
+
+    // Smallest rank whose dropped singular values stay within tolerance
+    double total = 0;
+    for (int i = 0; i < w.rows; ++i) {
+        total += w.at<double>(i) * w.at<double>(i);
+    }
+    int rank = w.rows;
+    double dropped = 0;
+    while (rank > 1) {
+        double s = w.at<double>(rank - 1);
+        if (std::sqrt(dropped + s * s) > tolerance * std::sqrt(total)) {
+            break;
+        }
+        dropped += s * s;
+        --rank;
+    }
+
+    if (rank == w.rows) {
+        return false;
+    }
+
+    // Split each singular value evenly between its column and row filter
+    plan.rank = rank;
+    plan.columnTaps.create(rank, kernel.rows(), CV_32F);
+    plan.rowTaps.create(rank, kernel.cols(), CV_32F);
+    for (int r = 0; r < rank; ++r) {
+        double scale = std::sqrt(w.at<double>(r));
+        for (int m = 0; m < kernel.rows(); ++m) {
+            plan.columnTaps.at<float>(r, m) = float(u.at<double>(m, r) * scale);
+        }
+        for (int n = 0; n < kernel.cols(); ++n) {
+            plan.rowTaps.at<float>(r, n) = float(vt.at<double>(r, n) * scale);
+        }
+    }
+    return true;
+}
+
+void filterRegionSeparable(const SourceBand& src, const FilterPlan& plan, const cv::Rect& roi, cv::Mat& dst) {
+    const int cn = src.rows.channels();
+    const int ry = plan.kernel.radiusY();
+    const int rx = plan.kernel.radiusX();
+    CV_Assert(src.rows.depth() == CV_8U && cn <= 4);
+    CV_Assert(std::max(roi.y - ry, 0) >= src.firstRow &&
+        std::min(roi.y + roi.height + ry, src.imageRows) <= src.firstRow + src.rows.rows);
+
+    // Window columns in image coordinates and the part inside the image
+    int x0 = roi.x - rx;
+    int windowCols = roi.width + 2 * rx;
+    int inX0 = std::max(x0, 0), inX1 = std::min(roi.x + roi.width + rx, src.rows.cols);
+
+    dst.create(roi.size(), CV_32FC(cn));
+
+    // Column pass result for one output row, zero outside the image
+    std::vector<float> column(windowCols * cn);
+
+    for (int i = 0; i < roi.height; ++i) {
+        float* out = dst.ptr<float>(i);
+        std::fill(out, out + roi.width * cn, 0.0f);
+
+        for (int r = 0; r < plan.rank; ++r) {
+            // Vertical pass over the kernel rows
+            const float* v = plan.columnTaps.ptr<float>(r);
+            std::fill(column.begin(), column.end(), 0.0f);
+            float* col = column.data() + (inX0 - x0) * cn;
+            for (int m = 0; m < plan.kernel.rows(); ++m) {
+                int y = roi.y + i + m - ry;
+                if (y < 0 || y >= src.imageRows) {
+                    continue;
+                }
+                const uchar* in = src.rows.ptr<uchar>(y - src.firstRow) + inX0 * cn;
+                for (int x = 0; x < (inX1 - inX0) * cn; ++x) {
+                    col[x] += v[m] * in[x];
+                }
+            }
+
+            // Horizontal pass over the kernel columns
+            const float* h = plan.rowTaps.ptr<float>(r);
+            for (int j = 0; j < roi.width; ++j) {
+                for (int c = 0; c < cn; ++c) {
+                    float sum = 0;
+                    for (int n = 0; n < plan.kernel.cols(); ++n) {
+                        sum += h[n] * column[(j + n) * cn + c];
+                    }
+                    out[j * cn + c] += sum;
+                }
+            }
+        }
+    }
+}
+
+}
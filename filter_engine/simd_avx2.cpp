@@ -0,0 +1,113 @@
+#include "simd_kernels.hpp"
+#include "static_kernels.hpp"
+
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2Ops {
+    static const int PIXELS = 16;
+
+    // unpacklo/hi work within 128-bit lanes: lo holds pixels 0-3 and 8-11,
+    // hi holds pixels 4-7 and 12-15 until storeInt() puts them back in order
+    struct IntAcc { __m256i lo, hi; };
+    struct FloatAcc { __m256 lo, hi; };
+    typedef __m256i IntWeight;
+    typedef __m256 FloatWeight;
+
+    static IntAcc zeroInt() { return IntAcc{ _mm256_setzero_si256(), _mm256_setzero_si256() }; }
+    static FloatAcc zeroFloat() { return FloatAcc{ _mm256_setzero_ps(), _mm256_setzero_ps() }; }
+
+    static IntWeight broadcastInt(int weights) { return _mm256_set1_epi32(weights); }
+    static FloatWeight broadcastFloat(float weight) { return _mm256_set1_ps(weight); }
+
+    static void maddPair(IntAcc& acc, const short* p0, const short* p1, IntWeight w) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)p0);
+        __m256i b = _mm256_loadu_si256((const __m256i*)p1);
+        acc.lo = _mm256_add_epi32(acc.lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), w));
+        acc.hi = _mm256_add_epi32(acc.hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), w));
+    }
+
+    // Separate multiply and add, so results round exactly like the scalar path
+    static void mulAdd(FloatAcc& acc, const float* p, FloatWeight w) {
+        acc.lo = _mm256_add_ps(acc.lo, _mm256_mul_ps(_mm256_loadu_ps(p), w));
+        acc.hi = _mm256_add_ps(acc.hi, _mm256_mul_ps(_mm256_loadu_ps(p + 8), w));
+    }
+
+    static void storeInt(float* out, const IntAcc& acc) {
+        __m256i first = _mm256_permute2x128_si256(acc.lo, acc.hi, 0x20);
+        __m256i second = _mm256_permute2x128_si256(acc.lo, acc.hi, 0x31);
+        _mm256_storeu_ps(out, _mm256_cvtepi32_ps(first));
+        _mm256_storeu_ps(out + 8, _mm256_cvtepi32_ps(second));
+    }
+
+    static void storeFloat(float* out, const FloatAcc& acc) {
+        _mm256_storeu_ps(out, acc.lo);
+        _mm256_storeu_ps(out + 8, acc.hi);
+    }
+
+    struct ShortAcc { __m256i v; };
+    struct ShortWeight { __m256i w0, w1; };
+
+    static ShortAcc zeroShort() { return ShortAcc{ _mm256_setzero_si256() }; }
+
+    static ShortWeight broadcastShort(int weights) {
+        return ShortWeight{ _mm256_set1_epi16(short(weights)), _mm256_set1_epi16(short(weights >> 16)) };
+    }
+
+    static void maddPairShort(ShortAcc& acc, const short* p0, const short* p1, const ShortWeight& w) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)p0);
+        __m256i b = _mm256_loadu_si256((const __m256i*)p1);
+        acc.v = _mm256_add_epi16(acc.v, _mm256_add_epi16(_mm256_mullo_epi16(a, w.w0), _mm256_mullo_epi16(b, w.w1)));
+    }
+
+    static void storeShort(short* out, const ShortAcc& acc) { _mm256_storeu_si256((__m256i*)out, acc.v); }
+};
+
+}
+
+#include "simd_rows.inl"
+
+namespace hpf {
+namespace simd {
+
+void intRowsAVX2(const short* plane, long stride, const IntTapPair* taps, int count,
+    int rows, int width, float* out, long outStride) {
+    intRows<Avx2Ops, WideSums<Avx2Ops>>(plane, stride, taps, count, rows, width, out, outStride);
+}
+
+void floatRowsAVX2(const float* plane, long stride, const FloatTap* taps, int count,
+    int rows, int width, float* out, long outStride) {
+    floatRows<Avx2Ops>(plane, stride, taps, count, rows, width, out, outStride);
+}
+
+bool intRowsFixedAVX2(int size, const short* plane, long stride, const int* weights,
+    int rows, int width, float* out, long outStride) {
+    return intRowsFixedSize<Avx2Ops, WideSums<Avx2Ops>>(size, plane, stride, weights, rows, width, out, outStride);
+}
+
+bool floatRowsFixedAVX2(int size, const float* plane, long stride, const float* weights,
+    int rows, int width, float* out, long outStride) {
+    return floatRowsFixedSize<Avx2Ops>(size, plane, stride, weights, rows, width, out, outStride);
+}
+
+void laplacianRowsAVX2(const short* plane, long stride, int rows, int width, float* out, long outStride) {
+    intRowsStatic<Avx2Ops, WideSums<Avx2Ops>, hpf::StaticLaplacian>(plane, stride, rows, width, out, outStride);
+}
+
+void shortRowsAVX2(const short* plane, long stride, const IntTapPair* taps, int count,
+    int rows, int width, short* out, long outStride) {
+    intRows<Avx2Ops, NarrowSums<Avx2Ops>>(plane, stride, taps, count, rows, width, out, outStride);
+}
+
+bool shortRowsFixedAVX2(int size, const short* plane, long stride, const int* weights,
+    int rows, int width, short* out, long outStride) {
+    return intRowsFixedSize<Avx2Ops, NarrowSums<Avx2Ops>>(size, plane, stride, weights, rows, width, out, outStride);
+}
+
+void laplacianShortRowsAVX2(const short* plane, long stride, int rows, int width, short* out, long outStride) {
+    intRowsStatic<Avx2Ops, NarrowSums<Avx2Ops>, hpf::StaticLaplacian>(plane, stride, rows, width, out, outStride);
+}
+
+}
+}
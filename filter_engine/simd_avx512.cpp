@@ -0,0 +1,116 @@
+#include "simd_kernels.hpp"
+#include "static_kernels.hpp"
+
+#include <immintrin.h>
+
+namespace {
+
+struct Avx512Ops {
+    static const int PIXELS = 32;
+
+    // unpacklo/hi work within 128-bit lanes: lo holds pixels 0-3, 8-11,
+    // 16-19 and 24-27, hi the other four groups until storeInt() reorders them
+    struct IntAcc { __m512i lo, hi; };
+    struct FloatAcc { __m512 lo, hi; };
+    typedef __m512i IntWeight;
+    typedef __m512 FloatWeight;
+
+    static IntAcc zeroInt() { return IntAcc{ _mm512_setzero_si512(), _mm512_setzero_si512() }; }
+    static FloatAcc zeroFloat() { return FloatAcc{ _mm512_setzero_ps(), _mm512_setzero_ps() }; }
+
+    static IntWeight broadcastInt(int weights) { return _mm512_set1_epi32(weights); }
+    static FloatWeight broadcastFloat(float weight) { return _mm512_set1_ps(weight); }
+
+    static void maddPair(IntAcc& acc, const short* p0, const short* p1, IntWeight w) {
+        __m512i a = _mm512_loadu_si512((const void*)p0);
+        __m512i b = _mm512_loadu_si512((const void*)p1);
+        acc.lo = _mm512_add_epi32(acc.lo, _mm512_madd_epi16(_mm512_unpacklo_epi16(a, b), w));
+        acc.hi = _mm512_add_epi32(acc.hi, _mm512_madd_epi16(_mm512_unpackhi_epi16(a, b), w));
+    }
+
+    // Separate multiply and add, so results round exactly like the scalar path
+    static void mulAdd(FloatAcc& acc, const float* p, FloatWeight w) {
+        acc.lo = _mm512_add_ps(acc.lo, _mm512_mul_ps(_mm512_loadu_ps(p), w));
+        acc.hi = _mm512_add_ps(acc.hi, _mm512_mul_ps(_mm512_loadu_ps(p + 16), w));
+    }
+
+    static void storeInt(float* out, const IntAcc& acc) {
+        // 64-bit element indices interleaving the 128-bit lanes of lo and hi
+        const __m512i firstHalf = _mm512_set_epi64(11, 10, 3, 2, 9, 8, 1, 0);
+        const __m512i secondHalf = _mm512_set_epi64(15, 14, 7, 6, 13, 12, 5, 4);
+        __m512i first = _mm512_permutex2var_epi64(acc.lo, firstHalf, acc.hi);
+        __m512i second = _mm512_permutex2var_epi64(acc.lo, secondHalf, acc.hi);
+        _mm512_storeu_ps(out, _mm512_cvtepi32_ps(first));
+        _mm512_storeu_ps(out + 16, _mm512_cvtepi32_ps(second));
+    }
+
+    static void storeFloat(float* out, const FloatAcc& acc) {
+        _mm512_storeu_ps(out, acc.lo);
+        _mm512_storeu_ps(out + 16, acc.hi);
+    }
+
+    struct ShortAcc { __m512i v; };
+    struct ShortWeight { __m512i w0, w1; };
+
+    static ShortAcc zeroShort() { return ShortAcc{ _mm512_setzero_si512() }; }
+
+    static ShortWeight broadcastShort(int weights) {
+        return ShortWeight{ _mm512_set1_epi16(short(weights)), _mm512_set1_epi16(short(weights >> 16)) };
+    }
+
+    static void maddPairShort(ShortAcc& acc, const short* p0, const short* p1, const ShortWeight& w) {
+        __m512i a = _mm512_loadu_si512((const void*)p0);
+        __m512i b = _mm512_loadu_si512((const void*)p1);
+        acc.v = _mm512_add_epi16(acc.v, _mm512_add_epi16(_mm512_mullo_epi16(a, w.w0), _mm512_mullo_epi16(b, w.w1)));
+    }
+
+    static void storeShort(short* out, const ShortAcc& acc) { _mm512_storeu_si512((void*)out, acc.v); }
+};
+
+}
+
+#include "simd_rows.inl"
+
+namespace hpf {
+namespace simd {
+
+void intRowsAVX512(const short* plane, long stride, const IntTapPair* taps, int count,
+    int rows, int width, float* out, long outStride) {
+    intRows<Avx512Ops, WideSums<Avx512Ops>>(plane, stride, taps, count, rows, width, out, outStride);
+}
+
+void floatRowsAVX512(const float* plane, long stride, const FloatTap* taps, int count,
+    int rows, int width, float* out, long outStride) {
+    floatRows<Avx512Ops>(plane, stride, taps, count, rows, width, out, outStride);
+}
+
+bool intRowsFixedAVX512(int size, const short* plane, long stride, const int* weights,
+    int rows, int width, float* out, long outStride) {
+    return intRowsFixedSize<Avx512Ops, WideSums<Avx512Ops>>(size, plane, stride, weights, rows, width, out, outStride);
+}
+
+bool floatRowsFixedAVX512(int size, const float* plane, long stride, const float* weights,
+    int rows, int width, float* out, long outStride) {
+    return floatRowsFixedSize<Avx512Ops>(size, plane, stride, weights, rows, width, out, outStride);
+}
+
+void laplacianRowsAVX512(const short* plane, long stride, int rows, int width, float* out, long outStride) {
+    intRowsStatic<Avx512Ops, WideSums<Avx512Ops>, hpf::StaticLaplacian>(plane, stride, rows, width, out, outStride);
+}
+
+void shortRowsAVX512(const short* plane, long stride, const IntTapPair* taps, int count,
+    int rows, int width, short* out, long outStride) {
+    intRows<Avx512Ops, NarrowSums<Avx512Ops>>(plane, stride, taps, count, rows, width, out, outStride);
+}
+
+bool shortRowsFixedAVX512(int size, const short* plane, long stride, const int* weights,
+    int rows, int width, short* out, long outStride) {
+    return intRowsFixedSize<Avx512Ops, NarrowSums<Avx512Ops>>(size, plane, stride, weights, rows, width, out, outStride);
+}
+
+void laplacianShortRowsAVX512(const short* plane, long stride, int rows, int width, short* out, long outStride) {
+    intRowsStatic<Avx512Ops, NarrowSums<Avx512Ops>, hpf::StaticLaplacian>(plane, stride, rows, width, out, outStride);
+}
+
+}
+}
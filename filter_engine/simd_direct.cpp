@@ -0,0 +1,420 @@
+#include "convolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "simd_kernels.hpp"
+#include "static_kernels.hpp"
+
+#if defined(HPF_X86_SIMD) && defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace hpf {
+
+// Largest magnitude float sums integers exactly up to
+static const double FLOAT_EXACT_LIMIT = 16777216.0;
+
+// Output rows filtered per pass over the planar window
+static const int BLOCK_ROWS = 64;
+
+const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::SSE2:
+        return "sse2";
+    case SimdLevel::AVX2:
+        return "avx2";
+    case SimdLevel::AVX512:
+        return "avx512";
+    case SimdLevel::None:
+    default:
+        return "scalar";
+    }
+}
+
+SimdLevel detectSimdLevel() {
+#if defined(HPF_X86_SIMD) && defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 1);
+    bool osxsave = (regs[2] & (1 << 27)) != 0;
+    bool avx = (regs[2] & (1 << 28)) != 0;
+    unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    __cpuidex(regs, 7, 0);
+    if ((xcr0 & 0xe6) == 0xe6 && (regs[1] & (1 << 16)) && (regs[1] & (1 << 30))) {
+        return SimdLevel::AVX512;
+    }
+    if (avx && (xcr0 & 0x6) == 0x6 && (regs[1] & (1 << 5))) {
+        return SimdLevel::AVX2;
+    }
+    return SimdLevel::SSE2;
+#elif defined(HPF_X86_SIMD)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        return SimdLevel::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::AVX2;
+    }
+    return SimdLevel::SSE2;
+#else
+    return SimdLevel::None;
+#endif
+}
+
+void prepareDirect(FilterPlan& plan, SimdLevel maxLevel) {
+    plan.simdLevel = std::min(detectSimdLevel(), maxLevel);
+
+    // Integer taps that fit int16 and keep every partial sum exact in float
+    // give the same result through the int16 multiply-add path
+    bool integral = true;
+    double positiveSum = 0, negativeSum = 0;
+    for (int m = 0; m < plan.kernel.rows(); ++m) {
+        const float* k = plan.kernel.taps.ptr<float>(m);
+        for (int n = 0; n < plan.kernel.cols(); ++n) {
+            integral = integral && k[n] == std::floor(k[n]) && std::fabs(k[n]) <= 32767;
+            (k[n] > 0 ? positiveSum : negativeSum) += std::fabs(k[n]);
+        }
+    }
+    plan.integerTaps = integral && (positiveSum + negativeSum) * 255 < FLOAT_EXACT_LIMIT;
+
+    // The response of 8-bit pixels lies in [-255 * negativeSum, 255 * positiveSum].
+    // When that fits int16, 16-bit sums are exact too: they wrap in between,
+    // but modulo 2^16 like the final value.
+    plan.shortAccumulator = plan.integerTaps && positiveSum * 255 <= 32767 && negativeSum * 255 <= 32768;
+
+    // Sizes with a compile-time unrolled row kernel
+    bool square = plan.kernel.rows() == plan.kernel.cols();
+    plan.unrolledSize = square && plan.kernel.rows() >= 3 && plan.kernel.rows() <= simd::MAX_UNROLLED_SIZE ? plan.kernel.rows() : 0;
+
+    plan.staticLaplacian = square && plan.kernel.rows() == StaticLaplacian::SIZE && plan.integerTaps;
+    for (int m = 0; plan.staticLaplacian && m < plan.kernel.rows(); ++m) {
+        for (int n = 0; n < plan.kernel.cols(); ++n) {
+            plan.staticLaplacian = plan.staticLaplacian && plan.kernel.taps.at<float>(m, n) == StaticLaplacian::tap(m, n);
+        }
+    }
+}
+
+#if defined(HPF_X86_SIMD)
+
+// Row kernels of one instruction set
+struct RowKernels {
+    simd::IntRowsFn intRows;
+    simd::FloatRowsFn floatRows;
+    simd::IntFixedRowsFn intFixedRows;
+    simd::FloatFixedRowsFn floatFixedRows;
+    simd::StaticRowsFn laplacianRows;
+    simd::ShortRowsFn shortRows;
+    simd::ShortFixedRowsFn shortFixedRows;
+    simd::StaticShortRowsFn laplacianShortRows;
+};
+
+static RowKernels rowKernels(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::AVX512:
+        return RowKernels{ simd::intRowsAVX512, simd::floatRowsAVX512, simd::intRowsFixedAVX512,
+            simd::floatRowsFixedAVX512, simd::laplacianRowsAVX512, simd::shortRowsAVX512, simd::shortRowsFixedAVX512,
+            simd::laplacianShortRowsAVX512 };
+    case SimdLevel::AVX2:
+        return RowKernels{ simd::intRowsAVX2, simd::floatRowsAVX2, simd::intRowsFixedAVX2,
+            simd::floatRowsFixedAVX2, simd::laplacianRowsAVX2, simd::shortRowsAVX2, simd::shortRowsFixedAVX2,
+            simd::laplacianShortRowsAVX2 };
+    case SimdLevel::SSE2:
+    default:
+        return RowKernels{ simd::intRowsSSE2, simd::floatRowsSSE2, simd::intRowsFixedSSE2,
+            simd::floatRowsFixedSSE2, simd::laplacianRowsSSE2, simd::shortRowsSSE2, simd::shortRowsFixedSSE2,
+            simd::laplacianShortRowsSSE2 };
+    }
+}
+
+void filterRegionDirectSimd(const SourceBand& src, const FilterPlan& plan, const cv::Rect& roi, cv::Mat& dst) {
+    const Kernel& kernel = plan.kernel;
+    const int cn = src.rows.channels();
+    const int ry = kernel.radiusY();
+    const int rx = kernel.radiusX();
+    CV_Assert(src.rows.depth() == CV_8U && cn <= 4);
+    CV_Assert(std::max(roi.y - ry, 0) >= src.firstRow &&
+        std::min(roi.y + roi.height + ry, src.imageRows) <= src.firstRow + src.rows.rows);
+
+    // Planar window around roi; rows are padded so whole vectors can be
+    // loaded and stored past the last output pixel
+    const int paddedWidth = (roi.width + simd::MAX_VECTOR_PIXELS - 1) / simd::MAX_VECTOR_PIXELS * simd::MAX_VECTOR_PIXELS;
+    const long stride = paddedWidth + kernel.cols();
+    const int windowRows = roi.height + kernel.rows() - 1;
+    int y0 = roi.y - ry, x0 = roi.x - rx;
+    int inY0 = std::max(y0, 0), inY1 = std::min(y0 + windowRows, src.imageRows);
+    int inX0 = std::max(x0, 0), inX1 = std::min(x0 + roi.width + kernel.cols() - 1, src.rows.cols);
+
+    // Tap lists in plane offsets for the generic loop, skipping zero taps,
+    // and the dense weights of the unrolled row kernels
+    std::vector<simd::IntTapPair> intTaps;
+    std::vector<simd::FloatTap> floatTaps;
+    std::vector<int> packedWeights;
+    std::vector<float> denseWeights;
+    for (int m = 0; m < kernel.rows(); ++m) {
+        const float* k = kernel.taps.ptr<float>(m);
+        for (int n = 0; n < kernel.cols(); n += 2) {
+            long offset = m * stride + n;
+            bool hasSecond = n + 1 < kernel.cols();
+            float w0 = k[n], w1 = hasSecond ? k[n + 1] : 0.0f;
+            if (plan.integerTaps) {
+                int weights = int((unsigned(int(w1)) << 16) | (unsigned(int(w0)) & 0xffff));
+                packedWeights.push_back(weights);
+                if (w0 != 0 || w1 != 0) {
+                    intTaps.push_back(simd::IntTapPair{ offset, hasSecond ? offset + 1 : offset, weights });
+                }
+            }
+            else {
+                denseWeights.push_back(w0);
+                if (w0 != 0) {
+                    floatTaps.push_back(simd::FloatTap{ offset, w0 });
+                }
+                if (hasSecond) {
+                    denseWeights.push_back(w1);
+                }
+                if (w1 != 0) {
+                    floatTaps.push_back(simd::FloatTap{ offset + 1, w1 });
+                }
+            }
+        }
+    }
+
+    RowKernels kernels = rowKernels(plan.simdLevel);
+
+    // 16-bit sums go straight into the output mode, wider ones into the response
+    const bool narrow = plan.shortAccumulator;
+    const OutputMode output = narrow ? plan.output : OutputMode::Response;
+    dst.create(roi.size(), output == OutputMode::Response ? CV_32FC(cn) : CV_8UC(cn));
+
+    // Blocks of output rows go through the planes one at a time, so the
+    // planes and the planar response stay small and in cache whatever the
+    // roi size
+    const int blockRows = std::min(std::max(BLOCK_ROWS, kernel.rows()), roi.height);
+    const int blockWindowRows = blockRows + kernel.rows() - 1;
+    std::vector<short> intPlane(plan.integerTaps ? size_t(blockWindowRows) * stride : 0);
+    std::vector<float> floatPlane(plan.integerTaps ? 0 : size_t(blockWindowRows) * stride);
+    std::vector<float> out(narrow ? 0 : size_t(blockRows) * paddedWidth);
+    std::vector<short> shortOut(narrow ? size_t(blockRows) * paddedWidth : 0);
+
+    // De-interleave one channel of window rows [top, top + rows) into plane,
+    // zero outside the image: only the margins are cleared, the samples are
+    // written once
+    auto fillPlane = [&](auto* plane, int c, int top, int rows) {
+        for (int r = 0; r < rows; ++r) {
+            int y = top + r;
+            auto* p = plane + r * stride;
+            if (y < inY0 || y >= inY1) {
+                std::fill(p, p + stride, 0);
+                continue;
+            }
+            std::fill(p, p + (inX0 - x0), 0);
+            std::fill(p + (inX1 - x0), p + stride, 0);
+            const uchar* in = src.rows.ptr<uchar>(y - src.firstRow) + inX0 * cn + c;
+            for (int x = inX0; x < inX1; ++x, in += cn) {
+                p[x - x0] = *in;
+            }
+        }
+    };
+
+    for (int i0 = 0; i0 < roi.height; i0 += blockRows) {
+        const int rows = std::min(blockRows, roi.height - i0);
+        for (int c = 0; c < cn; ++c) {
+            if (plan.integerTaps) {
+                fillPlane(intPlane.data(), c, y0 + i0, rows + kernel.rows() - 1);
+                if (narrow) {
+                    if (plan.staticLaplacian) {
+                        kernels.laplacianShortRows(intPlane.data(), stride, rows, roi.width, shortOut.data(), paddedWidth);
+                    }
+                    else if (!kernels.shortFixedRows(plan.unrolledSize, intPlane.data(), stride, packedWeights.data(),
+                        rows, roi.width, shortOut.data(), paddedWidth)) {
+                        kernels.shortRows(intPlane.data(), stride, intTaps.data(), int(intTaps.size()),
+                            rows, roi.width, shortOut.data(), paddedWidth);
+                    }
+                }
+                else if (plan.staticLaplacian) {
+                    kernels.laplacianRows(intPlane.data(), stride, rows, roi.width, out.data(), paddedWidth);
+                }
+                else if (!kernels.intFixedRows(plan.unrolledSize, intPlane.data(), stride, packedWeights.data(),
+                    rows, roi.width, out.data(), paddedWidth)) {
+                    kernels.intRows(intPlane.data(), stride, intTaps.data(), int(intTaps.size()),
+                        rows, roi.width, out.data(), paddedWidth);
+                }
+            }
+            else {
+                fillPlane(floatPlane.data(), c, y0 + i0, rows + kernel.rows() - 1);
+                if (!kernels.floatFixedRows(plan.unrolledSize, floatPlane.data(), stride, denseWeights.data(),
+                    rows, roi.width, out.data(), paddedWidth)) {
+                    kernels.floatRows(floatPlane.data(), stride, floatTaps.data(), int(floatTaps.size()),
+                        rows, roi.width, out.data(), paddedWidth);
+                }
+            }
+
+            // Interleave the channel back, finishing 16-bit sums like filterRegion() does
+            for (int i = 0; i < rows; ++i) {
+                if (!narrow) {
+                    const float* o = out.data() + size_t(i) * paddedWidth;
+                    float* d = dst.ptr<float>(i0 + i);
+                    for (int j = 0; j < roi.width; ++j) {
+                        d[j * cn + c] = o[j];
+                    }
+                    continue;
+                }
+                const short* o = shortOut.data() + size_t(i) * paddedWidth;
+                if (output == OutputMode::Response) {
+                    float* d = dst.ptr<float>(i0 + i);
+                    for (int j = 0; j < roi.width; ++j) {
+                        d[j * cn + c] = float(o[j]);
+                    }
+                }
+                else if (output == OutputMode::Saturate) {
+                    uchar* d = dst.ptr<uchar>(i0 + i);
+                    for (int j = 0; j < roi.width; ++j) {
+                        d[j * cn + c] = cv::saturate_cast<uchar>(o[j]);
+                    }
+                }
+                else {
+                    const uchar* pixel = src.rows.ptr<uchar>(roi.y + i0 + i - src.firstRow) + roi.x * cn;
+                    uchar* d = dst.ptr<uchar>(i0 + i);
+                    for (int j = 0; j < roi.width; ++j) {
+                        d[j * cn + c] = cv::saturate_cast<uchar>(float(o[j]) + plan.sharpenAlpha * pixel[j * cn + c]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+#else
+
+void filterRegionDirectSimd(const SourceBand& src, const FilterPlan& plan, const cv::Rect& roi, cv::Mat& dst) {
+    filterRegionDirect(src, plan.kernel, roi, dst);
+}
+
+#endif
+
+// Compare one plan at every SIMD level up to available against expected
+static int verifyLevels(const SourceBand& src, const cv::Rect& roi, FilterPlan plan, SimdLevel available,
+    const cv::Mat& expected, std::ostream& log) {
+    int mismatches = 0;
+    cv::Mat actual;
+    for (int level = int(SimdLevel::SSE2); level <= int(available); ++level) {
+        plan.simdLevel = SimdLevel(level);
+        filterRegionDirectSimd(src, plan, roi, actual);
+        if (cv::norm(expected, actual, cv::NORM_INF) != 0) {
+            log << "SIMD mismatch: " << describePlan(plan) << std::endl;
+            ++mismatches;
+        }
+    }
+    return mismatches;
+}
+
+// Random whole-number taps in [low, high)
+static cv::Mat randomIntegerTaps(int size, int low, int high) {
+    cv::Mat taps(size, size, CV_32F);
+    cv::randu(taps, cv::Scalar(low), cv::Scalar(high));
+    for (int m = 0; m < size; ++m) {
+        float* k = taps.ptr<float>(m);
+        for (int n = 0; n < size; ++n) {
+            k[n] = std::floor(k[n]);
+        }
+    }
+    return taps;
+}
+
+// Compare a prepared plan at every SIMD level against the scalar loop, then
+// again with its unrolled row kernel and its 16-bit sums turned off in turn
+static int verifyPlan(const SourceBand& src, const cv::Rect& roi, FilterPlan plan, std::ostream& log) {
+    SimdLevel available = plan.simdLevel;
+    cv::Mat expected;
+    filterRegionDirect(src, plan.kernel, roi, expected);
+    int mismatches = verifyLevels(src, roi, plan, available, expected, log);
+    if (plan.unrolledSize > 0) {
+        plan.unrolledSize = 0;
+        mismatches += verifyLevels(src, roi, plan, available, expected, log);
+    }
+    if (plan.shortAccumulator) {
+        plan.shortAccumulator = false;
+        mismatches += verifyLevels(src, roi, plan, available, expected, log);
+    }
+    return mismatches;
+}
+
+int verifySimdKernels(std::ostream& log) {
+    // Odd, non-vector-multiple width so every row ends in a partial vector
+    cv::Mat image(29, 83, CV_8UC3);
+    cv::randu(image, cv::Scalar(0), cv::Scalar(256));
+    SourceBand src{ image, 0, image.rows };
+    cv::Rect roi(0, 0, image.cols, image.rows);
+
+    int mismatches = 0;
+    for (int size = 1; size <= 63; size += 2) {
+        // Integer taps take the integer paths, fractional taps the float path
+        cv::Mat integerTaps = randomIntegerTaps(size, -9, 10);
+        integerTaps.at<float>(0, 0) = 0;
+        cv::Mat fractionalTaps(size, size, CV_32F);
+        cv::randu(fractionalTaps, cv::Scalar(-1), cv::Scalar(1));
+
+        for (bool integral : { true, false }) {
+            FilterPlan plan;
+            plan.kernel = makeKernel(integral ? integerTaps : fractionalTaps);
+            prepareDirect(plan, SimdLevel::AVX512);
+            if (plan.integerTaps != integral) {
+                log << "SIMD plan: " << describePlan(plan) << " took the wrong tap type" << std::endl;
+                ++mismatches;
+            }
+            if ((size >= 3 && size <= simd::MAX_UNROLLED_SIZE) != (plan.unrolledSize == size)) {
+                log << "SIMD plan: " << describePlan(plan) << " missed the unrolled row kernel" << std::endl;
+                ++mismatches;
+            }
+            mismatches += verifyPlan(src, roi, plan, log);
+        }
+    }
+
+    // Taps in {-1, 0, 1} keep every unrolled size within the 16-bit bound
+    for (int size = 1; size <= simd::MAX_UNROLLED_SIZE; size += 2) {
+        FilterPlan plan;
+        plan.kernel = makeKernel(randomIntegerTaps(size, -1, 2));
+        prepareDirect(plan, SimdLevel::AVX512);
+        if (!plan.shortAccumulator) {
+            log << "SIMD plan: " << describePlan(plan) << " missed the 16-bit sums" << std::endl;
+            ++mismatches;
+        }
+        mismatches += verifyPlan(src, roi, plan, log);
+    }
+
+    // Pixels of 0 and 255 drive 128 positive and 128 negative weight to the
+    // ends of the 16-bit bound, +-32640; one more positive weight has to
+    // fall back to 32-bit sums
+    cv::Mat extremes = image.clone();
+    for (int y = 0; y < extremes.rows; ++y) {
+        uchar* p = extremes.ptr<uchar>(y);
+        for (int x = 0; x < extremes.cols * extremes.channels(); ++x) {
+            p[x] = (p[x] & 1) ? 255 : 0;
+        }
+    }
+    SourceBand extremeSrc{ extremes, 0, extremes.rows };
+    for (int center : { 128, 129 }) {
+        cv::Mat taps(3, 3, CV_32F, cv::Scalar(-16));
+        taps.at<float>(1, 1) = float(center);
+        FilterPlan plan;
+        plan.kernel = makeKernel(taps);
+        prepareDirect(plan, SimdLevel::AVX512);
+        cv::Mat expected;
+        filterRegionDirect(extremeSrc, plan.kernel, roi, expected);
+        if (plan.shortAccumulator != (center == 128) || cv::norm(expected, cv::NORM_INF) != 255.0 * center) {
+            log << "SIMD plan: " << describePlan(plan) << " misjudged the 16-bit bound" << std::endl;
+            ++mismatches;
+        }
+        mismatches += verifyPlan(extremeSrc, roi, plan, log);
+    }
+
+    // Compile-time Laplacian against the same taps through the tap loop
+    FilterPlan plan;
+    plan.kernel = laplacianKernel();
+    prepareDirect(plan, SimdLevel::AVX512);
+    mismatches += verifyPlan(src, roi, plan, log);
+    return mismatches;
+}
+
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+// Row kernels of the planar SIMD direct path. One translation unit per
+// instruction set; they are compiled with that instruction set enabled, so
+// this header deliberately pulls in no OpenCV or standard library code that
+// could be shared with the rest of the engine.
+
+namespace hpf {
+namespace simd {
+
+// Two horizontally adjacent taps, applied as one widening multiply-add.
+// weights packs w0 in the low and w1 in the high 16 bits.
+struct IntTapPair {
+    long offset0;
+    long offset1;
+    int weights;
+};
+
+struct FloatTap {
+    long offset;
+    float weight;
+};
+
+// Output rows x width pixels of one channel. Output pixel (i, j) reads the
+// plane at i * stride + j + offset for every tap. Each output row is written
+// in whole vectors, so out rows and plane rows need slack up to the next
+// multiple of 32 pixels.
+typedef void (*IntRowsFn)(const short* plane, long stride, const IntTapPair* taps, int count,
+    int rows, int width, float* out, long outStride);
+typedef void (*FloatRowsFn)(const float* plane, long stride, const FloatTap* taps, int count,
+    int rows, int width, float* out, long outStride);
+
+// Same, unrolled at compile time for square kernels of size 3, 5, 7, 9 and
+// 11; return false for any other size. Integer weights hold (size + 1) / 2
+// packed pairs per kernel row, float weights all size * size taps.
+typedef bool (*IntFixedRowsFn)(int size, const short* plane, long stride, const int* weights,
+    int rows, int width, float* out, long outStride);
+typedef bool (*FloatFixedRowsFn)(int size, const float* plane, long stride, const float* weights,
+    int rows, int width, float* out, long outStride);
+
+// Same for the compile-time StaticLaplacian taps
+typedef void (*StaticRowsFn)(const short* plane, long stride, int rows, int width, float* out, long outStride);
+
+// Integer row kernels accumulating in 16-bit lanes and storing int16, for
+// kernels whose response fits int16 for any 8-bit input. Sums wrap in
+// between but the final value is exact.
+typedef void (*ShortRowsFn)(const short* plane, long stride, const IntTapPair* taps, int count,
+    int rows, int width, short* out, long outStride);
+typedef bool (*ShortFixedRowsFn)(int size, const short* plane, long stride, const int* weights,
+    int rows, int width, short* out, long outStride);
+typedef void (*StaticShortRowsFn)(const short* plane, long stride, int rows, int width, short* out, long outStride);
+
+void intRowsSSE2(const short* plane, long stride, const IntTapPair* taps, int count,
+    int rows, int width, float* out, long outStride);
+void floatRowsSSE2(const float* plane, long stride, const FloatTap* taps, int count,
+    int rows, int width, float* out, long outStride);
+bool intRowsFixedSSE2(int size, const short* plane, long stride, const int* weights,
+    int rows, int width, float* out, long outStride);
+bool floatRowsFixedSSE2(int size, const float* plane, long stride, const float* weights,
+    int rows, int width, float* out, long outStride);
+void laplacianRowsSSE2(const short* plane, long stride, int rows, int width, float* out, long outStride);
+void shortRowsSSE2(const short* plane, long stride, const IntTapPair* taps, int count,
+    int rows, int width, short* out, long outStride);
+bool shortRowsFixedSSE2(int size, const short* plane, long stride, const int* weights,
+    int rows, int width, short* out, long outStride);
+void laplacianShortRowsSSE2(const short* plane, long stride, int rows, int width, short* out, long outStride);
+
+void intRowsAVX2(const short* plane, long stride, const IntTapPair* taps, int count,
+    int rows, int width, float* out, long outStride);
+void floatRowsAVX2(const float* plane, long stride, const FloatTap* taps, int count,
+    int rows, int width, float* out, long outStride);
+bool intRowsFixedAVX2(int size, const short* plane, long stride, const int* weights,
+    int rows, int width, float* out, long outStride);
+bool floatRowsFixedAVX2(int size, const float* plane, long stride, const float* weights,
+    int rows, int width, float* out, long outStride);
+void laplacianRowsAVX2(const short* plane, long stride, int rows, int width, float* out, long outStride);
+void shortRowsAVX2(const short* plane, long stride, const IntTapPair* taps, int count,
+    int rows, int width, short* out, long outStride);
+bool shortRowsFixedAVX2(int size, const short* plane, long stride, const int* weights,
+    int rows, int width, short* out, long outStride);
+void laplacianShortRowsAVX2(const short* plane, long stride, int rows, int width, short* out, long outStride);
+
+void intRowsAVX512(const short* plane, long stride, const IntTapPair* taps, int count,
+    int rows, int width, float* out, long outStride);
+void floatRowsAVX512(const float* plane, long stride, const FloatTap* taps, int count,
+    int rows, int width, float* out, long outStride);
+bool intRowsFixedAVX512(int size, const short* plane, long stride, const int* weights,
+    int rows, int width, float* out, long outStride);
+bool floatRowsFixedAVX512(int size, const float* plane, long stride, const float* weights,
+    int rows, int width, float* out, long outStride);
+void laplacianRowsAVX512(const short* plane, long stride, int rows, int width, float* out, long outStride);
+void shortRowsAVX512(const short* plane, long stride, const IntTapPair* taps, int count,
+    int rows, int width, short* out, long outStride);
+bool shortRowsFixedAVX512(int size, const short* plane, long stride, const int* weights,
+    int rows, int width, short* out, long outStride);
+void laplacianShortRowsAVX512(const short* plane, long stride, int rows, int width, short* out, long outStride);
+
+// Widest pixel block any row kernel writes
+const int MAX_VECTOR_PIXELS = 32;
+
+// Largest kernel size with an unrolled row kernel
+const int MAX_UNROLLED_SIZE = 11;
+
+}
+}
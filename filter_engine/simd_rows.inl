@@ -0,0 +1,204 @@
+// Shared body of the SIMD row kernels, included by simd_sse2.cpp,
+// simd_avx2.cpp and simd_avx512.cpp after defining Ops.
+//
+// Ops::PIXELS                     output pixels per step
+// Ops::IntAcc / Ops::FloatAcc     accumulators for PIXELS outputs
+// Ops::IntWeight / FloatWeight    a broadcast tap weight
+// Ops::broadcastInt(w) / broadcastFloat(w)
+// Ops::zeroInt() / zeroFloat()
+// Ops::maddPair(acc, p0, p1, w)   acc += p0[j] * w0 + p1[j] * w1
+// Ops::mulAdd(acc, p, w)          acc += p[j] * w, rounded like the scalar path
+// Ops::storeInt(out, acc) / storeFloat(out, acc)
+// Ops::ShortAcc / Ops::ShortWeight  16-bit accumulators for PIXELS outputs, a broadcast tap pair
+// Ops::zeroShort() / broadcastShort(w) / maddPairShort(acc, p0, p1, w) / storeShort(out, acc)
+
+namespace {
+
+// Accumulators of the integer row kernels: 32-bit lanes through the
+// widening multiply-add, stored as float
+template <class Ops>
+struct WideSums {
+    typedef typename Ops::IntAcc Acc;
+    typedef typename Ops::IntWeight Weight;
+    typedef float Out;
+
+    static Acc zero() { return Ops::zeroInt(); }
+    static Weight broadcast(int weights) { return Ops::broadcastInt(weights); }
+    static void maddPair(Acc& acc, const short* p0, const short* p1, const Weight& w) { Ops::maddPair(acc, p0, p1, w); }
+    static void store(float* out, const Acc& acc) { Ops::storeInt(out, acc); }
+};
+
+// Or 16-bit lanes, half the registers and no widening, stored as int16
+template <class Ops>
+struct NarrowSums {
+    typedef typename Ops::ShortAcc Acc;
+    typedef typename Ops::ShortWeight Weight;
+    typedef short Out;
+
+    static Acc zero() { return Ops::zeroShort(); }
+    static Weight broadcast(int weights) { return Ops::broadcastShort(weights); }
+    static void maddPair(Acc& acc, const short* p0, const short* p1, const Weight& w) { Ops::maddPairShort(acc, p0, p1, w); }
+    static void store(short* out, const Acc& acc) { Ops::storeShort(out, acc); }
+};
+
+template <class Ops, class Sums>
+void intRows(const short* plane, long stride, const hpf::simd::IntTapPair* taps, int count,
+    int rows, int width, typename Sums::Out* out, long outStride) {
+    for (int i = 0; i < rows; ++i) {
+        const short* in = plane + i * stride;
+        typename Sums::Out* o = out + i * outStride;
+        for (int x = 0; x < width; x += Ops::PIXELS) {
+            typename Sums::Acc acc = Sums::zero();
+            for (int t = 0; t < count; ++t) {
+                Sums::maddPair(acc, in + x + taps[t].offset0, in + x + taps[t].offset1, Sums::broadcast(taps[t].weights));
+            }
+            Sums::store(o + x, acc);
+        }
+    }
+}
+
+template <class Ops>
+void floatRows(const float* plane, long stride, const hpf::simd::FloatTap* taps, int count,
+    int rows, int width, float* out, long outStride) {
+    for (int i = 0; i < rows; ++i) {
+        const float* in = plane + i * stride;
+        float* o = out + i * outStride;
+        for (int x = 0; x < width; x += Ops::PIXELS) {
+            typename Ops::FloatAcc acc = Ops::zeroFloat();
+            for (int t = 0; t < count; ++t) {
+                Ops::mulAdd(acc, in + x + taps[t].offset, Ops::broadcastFloat(taps[t].weight));
+            }
+            Ops::storeFloat(o + x, acc);
+        }
+    }
+}
+
+// Calls f(Index<0>()) ... f(Index<N - 1>()), so every call sees its index
+// as a compile-time constant
+template <int I>
+struct Index {
+    static const int value = I;
+};
+
+template <int N>
+struct Unroll {
+    template <class F>
+    static void run(F& f) {
+        Unroll<N - 1>::run(f);
+        f(Index<N - 1>());
+    }
+};
+
+template <>
+struct Unroll<0> {
+    template <class F>
+    static void run(F&) {}
+};
+
+// K x K kernel with the tap loop fully unrolled and the weights broadcast
+// once per call. weights holds (K + 1) / 2 packed pairs per kernel row; the
+// last pair of a row has a zero high weight.
+template <class Ops, class Sums, int K>
+void intRowsFixed(const short* plane, long stride, const int* weights,
+    int rows, int width, typename Sums::Out* out, long outStride) {
+    const int P = (K + 1) / 2;
+    typename Sums::Weight w[K * P];
+    for (int t = 0; t < K * P; ++t) {
+        w[t] = Sums::broadcast(weights[t]);
+    }
+
+    for (int i = 0; i < rows; ++i) {
+        const short* in = plane + i * stride;
+        typename Sums::Out* o = out + i * outStride;
+        for (int x = 0; x < width; x += Ops::PIXELS) {
+            typename Sums::Acc acc = Sums::zero();
+            auto tap = [&](auto t) {
+                const int m = decltype(t)::value / P;
+                const int n = 2 * (decltype(t)::value % P);
+                const short* p = in + x + m * stride + n;
+                Sums::maddPair(acc, p, n + 1 < K ? p + 1 : p, w[decltype(t)::value]);
+            };
+            Unroll<K * P>::run(tap);
+            Sums::store(o + x, acc);
+        }
+    }
+}
+
+template <class Ops, int K>
+void floatRowsFixed(const float* plane, long stride, const float* weights,
+    int rows, int width, float* out, long outStride) {
+    typename Ops::FloatWeight w[K * K];
+    for (int t = 0; t < K * K; ++t) {
+        w[t] = Ops::broadcastFloat(weights[t]);
+    }
+
+    for (int i = 0; i < rows; ++i) {
+        const float* in = plane + i * stride;
+        float* o = out + i * outStride;
+        for (int x = 0; x < width; x += Ops::PIXELS) {
+            typename Ops::FloatAcc acc = Ops::zeroFloat();
+            auto tap = [&](auto t) {
+                const int m = decltype(t)::value / K;
+                const int n = decltype(t)::value % K;
+                Ops::mulAdd(acc, in + x + m * stride + n, w[decltype(t)::value]);
+            };
+            Unroll<K * K>::run(tap);
+            Ops::storeFloat(o + x, acc);
+        }
+    }
+}
+
+// Kernel with compile-time taps: pairs of zero taps generate no code
+template <class Ops, class Sums, class Taps>
+void intRowsStatic(const short* plane, long stride, int rows, int width, typename Sums::Out* out, long outStride) {
+    const int K = Taps::SIZE;
+    const int P = (K + 1) / 2;
+
+    for (int i = 0; i < rows; ++i) {
+        const short* in = plane + i * stride;
+        typename Sums::Out* o = out + i * outStride;
+        for (int x = 0; x < width; x += Ops::PIXELS) {
+            typename Sums::Acc acc = Sums::zero();
+            auto tap = [&](auto t) {
+                constexpr int m = decltype(t)::value / P;
+                constexpr int n = 2 * (decltype(t)::value % P);
+                constexpr int w0 = Taps::tap(m, n);
+                constexpr int w1 = n + 1 < K ? Taps::tap(m, n + 1) : 0;
+                if constexpr (w0 != 0 || w1 != 0) {
+                    const short* p = in + x + m * stride + n;
+                    Sums::maddPair(acc, p, n + 1 < K ? p + 1 : p, Sums::broadcast(int((unsigned(w1) << 16) | (unsigned(w0) & 0xffff))));
+                }
+            };
+            Unroll<K * P>::run(tap);
+            Sums::store(o + x, acc);
+        }
+    }
+}
+
+template <class Ops, class Sums>
+bool intRowsFixedSize(int size, const short* plane, long stride, const int* weights,
+    int rows, int width, typename Sums::Out* out, long outStride) {
+    switch (size) {
+    case 3: intRowsFixed<Ops, Sums, 3>(plane, stride, weights, rows, width, out, outStride); return true;
+    case 5: intRowsFixed<Ops, Sums, 5>(plane, stride, weights, rows, width, out, outStride); return true;
+    case 7: intRowsFixed<Ops, Sums, 7>(plane, stride, weights, rows, width, out, outStride); return true;
+    case 9: intRowsFixed<Ops, Sums, 9>(plane, stride, weights, rows, width, out, outStride); return true;
+    case 11: intRowsFixed<Ops, Sums, 11>(plane, stride, weights, rows, width, out, outStride); return true;
+    default: return false;
+    }
+}
+
+template <class Ops>
+bool floatRowsFixedSize(int size, const float* plane, long stride, const float* weights,
+    int rows, int width, float* out, long outStride) {
+    switch (size) {
+    case 3: floatRowsFixed<Ops, 3>(plane, stride, weights, rows, width, out, outStride); return true;
+    case 5: floatRowsFixed<Ops, 5>(plane, stride, weights, rows, width, out, outStride); return true;
+    case 7: floatRowsFixed<Ops, 7>(plane, stride, weights, rows, width, out, outStride); return true;
+    case 9: floatRowsFixed<Ops, 9>(plane, stride, weights, rows, width, out, outStride); return true;
+    case 11: floatRowsFixed<Ops, 11>(plane, stride, weights, rows, width, out, outStride); return true;
+    default: return false;
+    }
+}
+
+}
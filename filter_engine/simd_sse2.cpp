@@ -0,0 +1,108 @@
+#include "simd_kernels.hpp"
+#include "static_kernels.hpp"
+
+#include <emmintrin.h>
+
+namespace {
+
+struct Sse2Ops {
+    static const int PIXELS = 8;
+
+    struct IntAcc { __m128i lo, hi; };
+    struct FloatAcc { __m128 lo, hi; };
+    typedef __m128i IntWeight;
+    typedef __m128 FloatWeight;
+
+    static IntAcc zeroInt() { return IntAcc{ _mm_setzero_si128(), _mm_setzero_si128() }; }
+    static FloatAcc zeroFloat() { return FloatAcc{ _mm_setzero_ps(), _mm_setzero_ps() }; }
+
+    static IntWeight broadcastInt(int weights) { return _mm_set1_epi32(weights); }
+    static FloatWeight broadcastFloat(float weight) { return _mm_set1_ps(weight); }
+
+    static void maddPair(IntAcc& acc, const short* p0, const short* p1, IntWeight w) {
+        __m128i a = _mm_loadu_si128((const __m128i*)p0);
+        __m128i b = _mm_loadu_si128((const __m128i*)p1);
+        acc.lo = _mm_add_epi32(acc.lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+        acc.hi = _mm_add_epi32(acc.hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+    }
+
+    static void mulAdd(FloatAcc& acc, const float* p, FloatWeight w) {
+        acc.lo = _mm_add_ps(acc.lo, _mm_mul_ps(_mm_loadu_ps(p), w));
+        acc.hi = _mm_add_ps(acc.hi, _mm_mul_ps(_mm_loadu_ps(p + 4), w));
+    }
+
+    static void storeInt(float* out, const IntAcc& acc) {
+        _mm_storeu_ps(out, _mm_cvtepi32_ps(acc.lo));
+        _mm_storeu_ps(out + 4, _mm_cvtepi32_ps(acc.hi));
+    }
+
+    static void storeFloat(float* out, const FloatAcc& acc) {
+        _mm_storeu_ps(out, acc.lo);
+        _mm_storeu_ps(out + 4, acc.hi);
+    }
+
+    struct ShortAcc { __m128i v; };
+    struct ShortWeight { __m128i w0, w1; };
+
+    static ShortAcc zeroShort() { return ShortAcc{ _mm_setzero_si128() }; }
+
+    static ShortWeight broadcastShort(int weights) {
+        return ShortWeight{ _mm_set1_epi16(short(weights)), _mm_set1_epi16(short(weights >> 16)) };
+    }
+
+    static void maddPairShort(ShortAcc& acc, const short* p0, const short* p1, const ShortWeight& w) {
+        __m128i a = _mm_loadu_si128((const __m128i*)p0);
+        __m128i b = _mm_loadu_si128((const __m128i*)p1);
+        acc.v = _mm_add_epi16(acc.v, _mm_add_epi16(_mm_mullo_epi16(a, w.w0), _mm_mullo_epi16(b, w.w1)));
+    }
+
+    static void storeShort(short* out, const ShortAcc& acc) { _mm_storeu_si128((__m128i*)out, acc.v); }
+};
+
+}
+
+#include "simd_rows.inl"
+
+namespace hpf {
+namespace simd {
+
+void intRowsSSE2(const short* plane, long stride, const IntTapPair* taps, int count,
+    int rows, int width, float* out, long outStride) {
+    intRows<Sse2Ops, WideSums<Sse2Ops>>(plane, stride, taps, count, rows, width, out, outStride);
+}
+
+void floatRowsSSE2(const float* plane, long stride, const FloatTap* taps, int count,
+    int rows, int width, float* out, long outStride) {
+    floatRows<Sse2Ops>(plane, stride, taps, count, rows, width, out, outStride);
+}
+
+bool intRowsFixedSSE2(int size, const short* plane, long stride, const int* weights,
+    int rows, int width, float* out, long outStride) {
+    return intRowsFixedSize<Sse2Ops, WideSums<Sse2Ops>>(size, plane, stride, weights, rows, width, out, outStride);
+}
+
+bool floatRowsFixedSSE2(int size, const float* plane, long stride, const float* weights,
+    int rows, int width, float* out, long outStride) {
+    return floatRowsFixedSize<Sse2Ops>(size, plane, stride, weights, rows, width, out, outStride);
+}
+
+void laplacianRowsSSE2(const short* plane, long stride, int rows, int width, float* out, long outStride) {
+    intRowsStatic<Sse2Ops, WideSums<Sse2Ops>, hpf::StaticLaplacian>(plane, stride, rows, width, out, outStride);
+}
+
+void shortRowsSSE2(const short* plane, long stride, const IntTapPair* taps, int count,
+    int rows, int width, short* out, long outStride) {
+    intRows<Sse2Ops, NarrowSums<Sse2Ops>>(plane, stride, taps, count, rows, width, out, outStride);
+}
+
+bool shortRowsFixedSSE2(int size, const short* plane, long stride, const int* weights,
+    int rows, int width, short* out, long outStride) {
+    return intRowsFixedSize<Sse2Ops, NarrowSums<Sse2Ops>>(size, plane, stride, weights, rows, width, out, outStride);
+}
+
+void laplacianShortRowsSSE2(const short* plane, long stride, int rows, int width, short* out, long outStride) {
+    intRowsStatic<Sse2Ops, NarrowSums<Sse2Ops>, hpf::StaticLaplacian>(plane, stride, rows, width, out, outStride);
+}
+
+}
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+// Kernels known at compile time. The SIMD row kernels specialize on them so
+// that zero taps disappear from the generated code.
+
+namespace hpf {
+
+// 3x3 Laplacian of the static kernel builds
+struct StaticLaplacian {
+    static const int SIZE = 3;
+
+    static constexpr int tap(int m, int n) {
+        return (m == 1 && n == 1) ? 4 : (m == 1 || n == 1) ? -1 : 0;
+    }
+};
+
+}
@@ -0,0 +1,194 @@
+#include "streaming.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace hpf {
+
+// Next number of a Netpbm header, skipping whitespace and comments
+static bool readHeaderValue(std::istream& in, int& value) {
+    for (;;) {
+        int c = in.peek();
+        if (c == '#') {
+            std::string comment;
+            std::getline(in, comment);
+        }
+        else if (c != EOF && std::isspace(c)) {
+            in.get();
+        }
+        else {
+            break;
+        }
+    }
+    return bool(in >> value);
+}
+
+bool NetpbmReader::open(const std::string& path) {
+    file.open(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error: Could not open " << path << "." << std::endl;
+        return false;
+    }
+
+    // Magic number, size and maximum sample, then one whitespace character
+    char magic[2] = {};
+    file.read(magic, 2);
+    channels = magic[0] != 'P' ? 0 : magic[1] == '5' ? 1 : magic[1] == '6' ? 3 : 0;
+    int width, height, maxValue;
+    if (!channels || !readHeaderValue(file, width) || !readHeaderValue(file, height) ||
+        !readHeaderValue(file, maxValue) || width <= 0 || height <= 0 || maxValue <= 0 || maxValue > 255) {
+        std::cerr << "Error: " << path << " is no binary 8-bit PGM or PPM image." << std::endl;
+        channels = 0;
+        return false;
+    }
+    file.get();
+    headerBytes = file.tellg();
+    imageSize = cv::Size(width, height);
+    return true;
+}
+
+bool NetpbmReader::read(cv::Mat& rows) {
+    std::streamsize rowBytes = std::streamsize(imageSize.width) * channels;
+    for (int i = 0; i < rows.rows; ++i) {
+        if (!file.read(reinterpret_cast<char*>(rows.ptr(i)), rowBytes)) {
+            std::cerr << "Error: The image ends early." << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool NetpbmWriter::create(const std::string& path, cv::Size size, int type) {
+    if (type != CV_8UC1 && type != CV_8UC3) {
+        std::cerr << "Error: Only 8-bit gray or 3-channel images can be written as PGM or PPM." << std::endl;
+        return false;
+    }
+    file.open(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error: Could not create " << path << "." << std::endl;
+        return false;
+    }
+    file << (type == CV_8UC1 ? "P5" : "P6") << '\n' << size.width << ' ' << size.height << "\n255\n";
+    return bool(file);
+}
+
+bool NetpbmWriter::write(const cv::Mat& rows) {
+    std::streamsize rowBytes = std::streamsize(rows.cols) * rows.elemSize();
+    for (int i = 0; i < rows.rows; ++i) {
+        if (!file.write(reinterpret_cast<const char*>(rows.ptr(i)), rowBytes)) {
+            std::cerr << "Error: Could not write the output image." << std::endl;
+            return false;
+        }
+    }
+    return bool(file.flush());
+}
+
+bool filterStream(const std::string& input, const std::string& output, const FilterPlan& plan,
+    const ExecutionPolicy& policy, int bandRows) {
+    if (plan.kernel.empty()) {
+        std::cerr << "Error: Empty image or kernel." << std::endl;
+        return false;
+    }
+    NetpbmReader reader;
+    NetpbmWriter writer;
+    if (!reader.open(input) || !writer.create(output, reader.size(), reader.type())) {
+        return false;
+    }
+    const int rows = reader.size().height;
+    const int cols = reader.size().width;
+    const int ry = plan.kernel.radiusY();
+
+    // Bands start at multiples of the alignment, like the splits of the backends
+    const int alignment = rowAlignment(plan);
+    if (bandRows <= 0) {
+        bandRows = std::max(4 * plan.kernel.rows(), 64);
+    }
+    bandRows = (bandRows + alignment - 1) / alignment * alignment;
+
+    // The filter saturates each band itself, unless the caller asked it to sharpen
+    FilterPlan finishing = plan;
+    if (finishing.output == OutputMode::Response) {
+        finishing.output = OutputMode::Saturate;
+    }
+
+    // Input rows [windowFirst, windowFirst + windowRows) of the image, one
+    // band and its halo at most, and the 8-bit output of one band
+    cv::Mat window(bandRows + 2 * ry, cols, reader.type());
+    cv::Mat converted(bandRows, cols, reader.type());
+    int windowFirst = 0;
+    int windowRows = 0;
+
+    const bool threaded = policy.backend == Backend::OpenMP || policy.backend == Backend::Hybrid;
+    for (int y = 0; y < rows; y += bandRows) {
+        int height = std::min(bandRows, rows - y);
+
+        // Keep the overlap the band still reads, drop the rows above it
+        int first = std::max(y - ry, 0);
+        if (first > windowFirst) {
+            int kept = std::max(windowFirst + windowRows - first, 0);
+            if (kept > 0) {
+                std::memmove(window.ptr(0), window.ptr(first - windowFirst), kept * window.step[0]);
+            }
+            windowFirst = first;
+            windowRows = kept;
+        }
+
+        // Read the rows below it up to the bottom of its halo
+        int last = std::min(y + height + ry, rows);
+        if (last > windowFirst + windowRows) {
+            cv::Mat fresh = window.rowRange(windowRows, last - windowFirst);
+            TraceScope phase("read", "io", fresh.rows * fresh.step[0]);
+            if (!reader.read(fresh)) {
+                return false;
+            }
+            windowRows = last - windowFirst;
+        }
+
+        SourceBand src{ window.rowRange(0, windowRows), windowFirst, rows };
+        cv::Rect roi(0, y, cols, height);
+        cv::Mat out = converted.rowRange(0, height);
+        {
+            TraceScope phase("filter", "compute", out.rows * out.step[0]);
+            if (threaded) {
+                filterRegionOpenMP(src, finishing, roi, out, policy);
+            }
+            else {
+                filterRegion(src, finishing, roi, out);
+            }
+        }
+        TraceScope phase("write", "io", out.rows * out.step[0]);
+        if (!writer.write(out)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parseStreamArgs(int argc, char** argv, ExecutionPolicy& policy, int& bandRows) {
+    // Everything else goes to parseExecutionArgs() with the program name
+    std::vector<char*> rest{ argv[0] };
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option != "--band-rows") {
+            rest.push_back(argv[i]);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Error: Missing value for " << option << "." << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+        bandRows = std::atoi(value.c_str());
+        if (bandRows <= 0) {
+            std::cerr << "Error: Invalid value " << value << " for " << option << "." << std::endl;
+            return false;
+        }
+    }
+    return parseExecutionArgs(int(rest.size()), rest.data(), policy);
+}
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+
+#include "filter_engine.hpp"
+
+namespace hpf {
+
+// Binary Netpbm image (P5 gray or P6 color, 8-bit samples) read from top to
+// bottom a few rows at a time. Samples keep their file order, which the
+// filter does not care about.
+class NetpbmReader {
+public:
+    // Prints the problem and returns false if path is no such image
+    bool open(const std::string& path);
+
+    cv::Size size() const { return imageSize; }
+    int type() const { return CV_8UC(channels); }
+
+    // Byte offset of the first sample in the file
+    std::streamoff dataOffset() const { return headerBytes; }
+
+    // Fill every row of rows (size().width columns of type()) with the next image rows
+    bool read(cv::Mat& rows);
+
+private:
+    std::ifstream file;
+    cv::Size imageSize;
+    int channels = 0;
+    std::streamoff headerBytes = 0;
+};
+
+// Binary Netpbm image written from top to bottom a few rows at a time
+class NetpbmWriter {
+public:
+    // CV_8UC1 images become P5, CV_8UC3 images P6. Prints the problem and
+    // returns false if the file cannot be created or the type has no format.
+    bool create(const std::string& path, cv::Size size, int type);
+
+    bool write(const cv::Mat& rows);
+
+private:
+    std::ofstream file;
+};
+
+// Filter the Netpbm image input into the Netpbm image output, sharpened if
+// plan.output asks for it and saturated to 8 bits otherwise, holding only
+// bandRows output rows and the bandRows + kernel rows - 1 input rows they
+// read at a time: the input rows the next band still needs move to the
+// front of the window, the rest of it is read anew. Peak memory is
+// O(width * (bandRows + kernel rows)) whatever the image height.
+// bandRows of 0 picks a few kernel heights; it is rounded up to
+// rowAlignment(), so the output matches the whole-image response exactly.
+// Backend::OpenMP and Hybrid filter each band with the threads of policy,
+// every other backend sequentially in this process. Prints the problem and
+// returns false on a read or write error.
+bool filterStream(const std::string& input, const std::string& output, const FilterPlan& plan,
+    const ExecutionPolicy& policy, int bandRows = 0);
+
+// Parse --band-rows N of the command line into bandRows and the rest with
+// parseExecutionArgs() into policy.
+bool parseStreamArgs(int argc, char** argv, ExecutionPolicy& policy, int& bandRows);
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <algorithm>
+
+namespace hpf {
+
+// Row ranges of the image splits shared by the backends
+
+// Rows [y, y + height) of the image
+struct Strip {
+    int y;
+    int height;
+
+    int end() const { return y + height; }
+};
+
+// Strip of part index out of count: a balanced split of the image rows in
+// units of alignment rows, the first parts taking one unit more
+inline Strip partStrip(int index, int count, int rows, int alignment) {
+    int units = (rows + alignment - 1) / alignment;
+    int perPart = units / count;
+    int remainder = units % count;
+    int first = index * perPart + std::min(index, remainder);
+    int length = perPart + (index < remainder ? 1 : 0);
+    int y = std::min(first * alignment, rows);
+    return Strip{ y, std::min((first + length) * alignment, rows) - y };
+}
+
+// Rows of strip [y, end) plus radius rows of halo either side, inside the image
+inline Strip haloStrip(const Strip& strip, int radius, int rows) {
+    if (strip.height == 0) {
+        return strip;
+    }
+    int y = std::max(strip.y - radius, 0);
+    return Strip{ y, std::min(strip.end() + radius, rows) - y };
+}
+
+inline Strip intersect(const Strip& a, const Strip& b) {
+    int y = std::max(a.y, b.y);
+    return Strip{ y, std::max(std::min(a.end(), b.end()) - y, 0) };
+}
+
+}
@@ -0,0 +1,86 @@
+#include "tiling.hpp"
+#include "simd_kernels.hpp"
+
+#include <algorithm>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <vector>
+#else
+#include <unistd.h>
+#endif
+
+namespace hpf {
+
+// Narrowest tile, two blocks of the widest row kernel
+static const int MIN_TILE_COLS = 2 * simd::MAX_VECTOR_PIXELS;
+
+// Shortest tile, so the halo rows stay a small part of the window
+static const int MIN_TILE_ROWS = 16;
+
+CacheSizes detectCacheSizes() {
+    CacheSizes caches;
+#if defined(_WIN32)
+    DWORD bytes = 0;
+    GetLogicalProcessorInformation(nullptr, &bytes);
+    std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(bytes / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+    if (!info.empty() && GetLogicalProcessorInformation(info.data(), &bytes)) {
+        for (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION& entry : info) {
+            if (entry.Relationship != RelationCache || entry.Cache.Type == CacheInstruction) {
+                continue;
+            }
+            if (entry.Cache.Level == 1) {
+                caches.l1 = entry.Cache.Size;
+            }
+            else if (entry.Cache.Level == 2) {
+                caches.l2 = entry.Cache.Size;
+            }
+        }
+    }
+#elif defined(_SC_LEVEL1_DCACHE_SIZE) && defined(_SC_LEVEL2_CACHE_SIZE)
+    long l1 = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+    long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (l1 > 0) {
+        caches.l1 = size_t(l1);
+    }
+    if (l2 > 0) {
+        caches.l2 = size_t(l2);
+    }
+#endif
+    return caches;
+}
+
+cv::Size chooseTileSize(const FilterPlan& plan, int channels, cv::Size imageSize, const CacheSizes& caches) {
+    const int kRows = plan.kernel.rows();
+    const int kCols = plan.kernel.cols();
+
+    if (plan.strategy == Strategy::BoxComplement || plan.strategy == Strategy::FFT) {
+        return cv::Size();
+    }
+
+    // Bytes per pixel of what the inner loop reads: SIMD planes hold one
+    // channel at a time, the scalar and separable paths read interleaved bytes
+    size_t inBytes = channels;
+    if (plan.strategy == Strategy::Direct && plan.simdLevel != SimdLevel::None) {
+        inBytes = plan.integerTaps ? sizeof(short) : sizeof(float);
+    }
+    size_t outBytes = sizeof(float) * channels;
+
+    // Width: kernel-height band of the input window in half of L1
+    size_t bandPixels = caches.l1 / 2 / (kRows * inBytes);
+    int cols = int(bandPixels) - (kCols - 1);
+    cols = cols / simd::MAX_VECTOR_PIXELS * simd::MAX_VECTOR_PIXELS;
+    cols = std::min(std::max(cols, MIN_TILE_COLS), imageSize.width);
+
+    // Height: input window with halo plus the response in half of L2
+    size_t windowCols = cols + kCols - 1;
+    size_t perRow = windowCols * (channels + inBytes) + cols * outBytes;
+    size_t budget = caches.l2 / 2;
+    size_t haloBytes = (kRows - 1) * windowCols * (channels + inBytes);
+    int rows = budget > haloBytes ? int((budget - haloBytes) / perRow) : 0;
+    rows = std::min(std::max(rows, std::max(MIN_TILE_ROWS, kRows)), imageSize.height);
+    return cv::Size(cols, rows);
+}
+
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include "convolution.hpp"
+
+namespace hpf {
+
+// Per-core data cache sizes in bytes
+struct CacheSizes {
+    size_t l1 = 32 * 1024;
+    size_t l2 = 256 * 1024;
+};
+
+// Sizes reported by the OS, or the defaults above where it reports none
+CacheSizes detectCacheSizes();
+
+// Output tile whose input window and response stay cache resident: the
+// kernel-height band of input rows one output row reads fits in half of L1,
+// the whole tile with its halo in half of L2. Returns an empty size for
+// box-complement and FFT plans, which already stream their own windows.
+cv::Size chooseTileSize(const FilterPlan& plan, int channels, cv::Size imageSize, const CacheSizes& caches);
+
+}
@@ -0,0 +1,140 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace hpf {
+
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    double start;
+    double duration;
+    long long bytes;
+};
+
+// Phases of one thread. Each thread appends to its own buffer, so recording
+// takes no lock; buffers outlive their threads until the trace is written.
+struct ThreadTrace {
+    int thread;
+    std::vector<TraceEvent> events;
+};
+
+static std::atomic<bool> enabled{ false };
+static std::mutex registryMutex;
+static std::vector<std::unique_ptr<ThreadTrace>> registry;
+
+static double now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static ThreadTrace& threadTrace() {
+    thread_local ThreadTrace* local = nullptr;
+    if (!local) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.push_back(std::make_unique<ThreadTrace>());
+        local = registry.back().get();
+        local->thread = int(registry.size()) - 1;
+    }
+    return *local;
+}
+
+void setTracing(bool on) {
+    enabled = on;
+}
+
+bool tracing() {
+    return enabled.load(std::memory_order_relaxed);
+}
+
+TraceScope::TraceScope(const char* name, const char* category, long long bytes) :
+    name(name), category(category), bytes(bytes), start(tracing() ? now() : -1) {}
+
+TraceScope::~TraceScope() {
+    if (start >= 0) {
+        threadTrace().events.push_back(TraceEvent{ name, category, start, now() - start, bytes });
+    }
+}
+
+bool writeTrace(const std::string& path, MPI_Comm comm, int root) {
+    int initialized = 0, finalized = 0;
+    MPI_Initialized(&initialized);
+    MPI_Finalized(&finalized);
+    const bool distributed = initialized && !finalized;
+    int rank = 0, size = 1;
+    if (distributed) {
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &size);
+        MPI_Barrier(comm);
+    }
+
+    // Times relative to the barrier every rank just left, shifted so the
+    // earliest phase of any rank starts at zero
+    double sync = now();
+    std::vector<ThreadTrace> threads;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (auto& trace : registry) {
+            threads.push_back(*trace);
+            trace->events.clear();
+        }
+    }
+    double earliest = 0;
+    for (const ThreadTrace& trace : threads) {
+        for (const TraceEvent& event : trace.events) {
+            earliest = std::min(earliest, event.start - sync);
+        }
+    }
+    if (distributed) {
+        MPI_Allreduce(MPI_IN_PLACE, &earliest, 1, MPI_DOUBLE, MPI_MIN, comm);
+    }
+
+    // Complete events in microseconds, one process per rank
+    std::ostringstream json;
+    json << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << rank << ",\"args\":{\"name\":\"rank " << rank
+        << "\"}},\n";
+    for (const ThreadTrace& trace : threads) {
+        for (const TraceEvent& event : trace.events) {
+            json << "{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category << "\",\"ph\":\"X\",\"ts\":"
+                << (event.start - sync - earliest) * 1e6 << ",\"dur\":" << event.duration * 1e6 << ",\"pid\":" << rank
+                << ",\"tid\":" << trace.thread << ",\"args\":{\"bytes\":" << event.bytes << "}},\n";
+        }
+    }
+    std::string mine = json.str();
+
+    // Every rank's events to the root
+    std::vector<int> lengths(size, int(mine.size())), offsets(size, 0);
+    std::string all = mine;
+    if (distributed) {
+        int length = int(mine.size());
+        MPI_Gather(&length, 1, MPI_INT, lengths.data(), 1, MPI_INT, root, comm);
+        if (rank == root) {
+            for (int r = 1; r < size; ++r) {
+                offsets[r] = offsets[r - 1] + lengths[r - 1];
+            }
+            all.resize(size_t(offsets[size - 1]) + lengths[size - 1]);
+        }
+        MPI_Gatherv(mine.data(), length, MPI_CHAR, &all[0], lengths.data(), offsets.data(), MPI_CHAR, root, comm);
+    }
+    if (rank != root) {
+        return true;
+    }
+
+    std::ofstream file(path);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" << all.substr(0, all.size() - 2) << "\n]}\n";
+    if (!file) {
+        std::cerr << "Error: Could not write the trace to " << path << "." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+}
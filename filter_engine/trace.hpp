@@ -0,0 +1,42 @@
+#pragma once
+
+#include <mpi.h>
+#include <string>
+
+namespace hpf {
+
+// Timeline of the phases every rank and thread goes through, with the bytes
+// each phase moves, for finding load imbalance and communication stalls.
+// Off by default; while off a TraceScope costs one branch.
+void setTracing(bool enabled);
+bool tracing();
+
+// Records the enclosing scope as one phase of the calling thread. name and
+// category must outlive the trace, string literals in practice. Categories
+// used by the engine: "io", "compute", "mpi" for transfers and "wait" for
+// time blocked in MPI or a queue.
+class TraceScope {
+public:
+    TraceScope(const char* name, const char* category, long long bytes = 0);
+    ~TraceScope();
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    void addBytes(long long count) { bytes += count; }
+
+private:
+    const char* name;
+    const char* category;
+    long long bytes;
+    double start;
+};
+
+// Merge the phases of every rank of comm on root and write them to path as
+// Chrome trace JSON (chrome://tracing or ui.perfetto.dev), one process per
+// rank and one row per thread, then clear them. Clocks are aligned at a
+// barrier inside the call. Every rank of comm must call it while none of its
+// threads records; without MPI only the own phases are written. Prints the
+// problem and returns false on root if the file cannot be written.
+bool writeTrace(const std::string& path, MPI_Comm comm, int root = 0);
+
+}
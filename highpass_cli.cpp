@@ -0,0 +1,240 @@
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <mpi.h>
+#include <omp.h>
+#include <string>
+#include <vector>
+
+#include "filter_engine/filter_engine.hpp"
+
+using namespace std;
+
+// Everything the CLI takes besides the execution options
+struct Settings {
+    string kernel;
+    string input;
+    string output;
+    string outputMode = "saturate";
+    int repeats = 1;
+    bool json = true;
+};
+
+// Split the CLI options off and hand the rest to parseExecutionArgs()
+static bool parseArgs(int argc, char** argv, Settings& settings, hpf::FilterPlan& modes,
+    hpf::ExecutionPolicy& policy) {
+    vector<char*> rest{ argv[0] };
+    for (int i = 1; i < argc; ++i) {
+        string option = argv[i];
+        bool known = option == "--backend" || option == "--output" || option == "--repeats" || option == "--summary";
+        if (!known) {
+            rest.push_back(argv[i]);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            cerr << "Error: Missing value for " << option << "." << endl;
+            return false;
+        }
+        string value = argv[++i];
+        bool valid = true;
+        if (option == "--backend") {
+            valid = hpf::parseBackend(value, policy);
+        }
+        else if (option == "--output") {
+            valid = hpf::parseOutputMode(value, modes);
+            settings.outputMode = value;
+        }
+        else if (option == "--repeats") {
+            settings.repeats = atoi(value.c_str());
+            valid = settings.repeats > 0;
+        }
+        else {
+            valid = value == "json" || value == "text";
+            settings.json = value == "json";
+        }
+        if (!valid) {
+            cerr << "Error: Invalid value " << value << " for " << option << "." << endl;
+            return false;
+        }
+    }
+    return hpf::parseExecutionArgs(int(rest.size()), rest.data(), policy);
+}
+
+// "laplacian" or the odd size of a generated high-pass kernel
+static hpf::Kernel makeKernel(const string& spec) {
+    if (spec == "laplacian") {
+        return hpf::laplacianKernel();
+    }
+    char* end = nullptr;
+    long size = strtol(spec.c_str(), &end, 10);
+    if (end == spec.c_str() || *end != '\0') {
+        cerr << "Error: Unknown kernel " << spec << "." << endl;
+        return hpf::Kernel();
+    }
+    return hpf::generateHighPassKernel(int(size));
+}
+
+// text as a JSON string
+static string quoted(const string& text) {
+    string result = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        }
+        else if (c >= 0 && c < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            result += escape;
+        }
+        else {
+            result += c;
+        }
+    }
+    return result + "\"";
+}
+
+// Usage: [mpirun -np N] highpass_cli <kernel size|laplacian> <input> <output> [--backend sequential|openmp|mpi|hybrid]
+//   [--output saturate|sharpen[,alpha]|response] [--repeats N] [--summary json|text] [options]
+int main(int argc, char** argv) {
+    // Hybrid needs the main thread of each rank to own MPI
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    // Kernel, input and output come first, the options after them. One rank
+    // defaults to all threads of the node, several to hybrid.
+    Settings settings;
+    hpf::FilterPlan modes;
+    modes.output = hpf::OutputMode::Saturate;
+    hpf::ExecutionPolicy policy;
+    policy.backend = size == 1 ? hpf::Backend::OpenMP : hpf::Backend::Hybrid;
+    policy.tiled = true;
+    if (argc < 4) {
+        if (rank == 0) {
+            cerr << "Usage: " << argv[0] << " <kernel size|laplacian> <input> <output> [--backend "
+                "sequential|openmp|mpi|hybrid] [--output saturate|sharpen[,alpha]|response] [--repeats N] "
+                "[--summary json|text] [options]" << endl;
+        }
+        MPI_Finalize();
+        return 1;
+    }
+    settings.kernel = argv[1];
+    settings.input = argv[2];
+    settings.output = argv[3];
+    if (!parseArgs(argc - 3, argv + 3, settings, modes, policy)) {
+        MPI_Finalize();
+        return 1;
+    }
+    const bool distributed = policy.backend == hpf::Backend::MPI || policy.backend == hpf::Backend::Hybrid;
+    if (policy.backend == hpf::Backend::Hybrid && provided < MPI_THREAD_FUNNELED) {
+        policy.backend = hpf::Backend::MPI;
+    }
+    if (!distributed && size > 1) {
+        if (rank == 0) {
+            cerr << "Error: The " << hpf::backendName(policy.backend) << " backend runs on one rank." << endl;
+        }
+        MPI_Finalize();
+        return 1;
+    }
+
+    // Only rank 0 decodes the image and picks how the kernel is evaluated
+    double start = MPI_Wtime();
+    cv::Mat image;
+    hpf::FilterPlan plan;
+    if (rank == 0) {
+        {
+            hpf::TraceScope phase("imread", "io");
+            image = cv::imread(settings.input, cv::IMREAD_COLOR);
+        }
+        hpf::Kernel kernel = makeKernel(settings.kernel);
+        if (image.empty()) {
+            cerr << "Error: Could not open or read " << settings.input << "." << endl;
+        }
+        else if (!kernel.empty() && hpf::isSupportedImage(image)) {
+            hpf::PlanOptions options;
+            options.imageSize = image.size();
+            plan = hpf::cachedFilterPlan(kernel, options);
+            plan.output = modes.output;
+            plan.sharpenAlpha = modes.sharpenAlpha;
+        }
+    }
+    double readSeconds = MPI_Wtime() - start;
+    if (distributed) {
+        hpf::broadcastPlan(plan, 0, MPI_COMM_WORLD);
+    }
+    if (plan.kernel.empty()) {
+        MPI_Finalize();
+        return 1;
+    }
+
+    // Every run starts together on all ranks and ends when rank 0 holds the result
+    vector<double> times;
+    cv::Mat output;
+    for (int run = 0; run < settings.repeats; ++run) {
+        if (distributed) {
+            MPI_Barrier(MPI_COMM_WORLD);
+        }
+        double runStart = MPI_Wtime();
+        output = hpf::convolve(image, plan, policy);
+        times.push_back(MPI_Wtime() - runStart);
+    }
+
+    // The format follows the extension of the output; the float response
+    // needs one that holds 32-bit floats, such as .tiff, .exr or .pfm
+    int status = 0;
+    if (rank == 0) {
+        double writeStart = MPI_Wtime();
+        bool written;
+        {
+            hpf::TraceScope phase("imwrite", "io", output.total() * output.elemSize());
+            written = cv::imwrite(settings.output, output);
+        }
+        double writeSeconds = MPI_Wtime() - writeStart;
+        if (!written) {
+            cerr << "Error: Could not write " << settings.output << "." << endl;
+            status = 1;
+        }
+
+        sort(times.begin(), times.end());
+        double median = times[times.size() / 2];
+        double megapixels = double(image.total()) / 1e6;
+        int threads = policy.backend == hpf::Backend::Sequential || policy.backend == hpf::Backend::MPI ? 1 :
+            policy.threads > 0 ? policy.threads : omp_get_max_threads();
+        if (settings.json) {
+            cout << "{ \"input\": " << quoted(settings.input) << ", \"output\": " << quoted(settings.output)
+                << ", \"written\": " << (written ? "true" : "false") << ", \"width\": " << image.cols
+                << ", \"height\": " << image.rows << ", \"channels\": " << image.channels() << ", \"kernel\": "
+                << plan.kernel.taps.cols << ", \"strategy\": " << quoted(hpf::describePlan(plan))
+                << ", \"output_mode\": " << quoted(settings.outputMode) << ", \"backend\": \""
+                << hpf::backendName(policy.backend) << "\", \"ranks\": " << size << ", \"threads\": " << threads
+                << ", \"repeats\": " << settings.repeats << ", \"read_ms\": " << readSeconds * 1000
+                << ", \"filter_median_ms\": " << median * 1000 << ", \"filter_min_ms\": " << times.front() * 1000
+                << ", \"write_ms\": " << writeSeconds * 1000 << ", \"mpixels_per_s\": " << megapixels / median
+                << " }" << endl;
+        }
+        else {
+            cout << "input: " << settings.input << " (" << image.cols << "x" << image.rows << "x"
+                << image.channels() << ")\n"
+                << "output: " << settings.output << (written ? "" : " (not written)") << "\n"
+                << "strategy: " << hpf::describePlan(plan) << ", " << settings.outputMode << "\n"
+                << "backend: " << hpf::backendName(policy.backend) << ", " << size << " ranks, " << threads
+                << " threads\n"
+                << "read: " << readSeconds * 1000 << " ms\n"
+                << "filter: median " << median * 1000 << " ms, min " << times.front() * 1000 << " ms over "
+                << settings.repeats << " runs, " << megapixels / median << " Mpixel/s\n"
+                << "write: " << writeSeconds * 1000 << " ms" << endl;
+        }
+    }
+    MPI_Bcast(&status, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (!policy.tracePath.empty()) {
+        hpf::writeTrace(policy.tracePath, MPI_COMM_WORLD);
+    }
+    MPI_Finalize();
+    return status;
+}
@@ -0,0 +1,110 @@
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include <mpi.h>
+
+#include "filter_engine/filter_engine.hpp"
+
+using namespace cv;
+using namespace std;
+
+void parallelHighPassFilter(const Mat& imageData, const hpf::Kernel& kernel, hpf::ExecutionPolicy policy, int rank, int size, double start_s) {
+    // Rank 0 picks how the kernel is evaluated, for every rank
+    hpf::FilterPlan plan;
+    if (rank == 0) {
+        hpf::PlanOptions options;
+        options.imageSize = imageData.size();
+        plan = hpf::cachedFilterPlan(kernel, options);
+        plan.output = hpf::OutputMode::Saturate;  // 8-bit strips, ready for display
+        cout << "Filter strategy: " << hpf::describePlan(plan) << endl;
+    }
+    hpf::broadcastPlan(plan, 0, MPI_COMM_WORLD);
+    if (plan.kernel.empty()) {
+        return;
+    }
+
+    // Rank 0 scatters the strips, every rank filters its strip with all its
+    // threads and rank 0 assembles the result
+    hpf::SchedulerStats stats;
+    policy.stats = &stats;
+    Mat processedImage = hpf::convolve(imageData, plan, policy);
+
+    if (rank == 0) {
+        if (policy.distribution == hpf::Distribution::Dynamic) {
+            cout << hpf::describeStats(stats);
+        }
+
+        // Wall time: clock() would add up the CPU time of every thread
+        double TotalTime = (MPI_Wtime() - start_s) * 1000;
+        std::cout << "time: " << TotalTime << "ms" << endl;
+
+        // Display final processed image
+        imshow("Processed Image", processedImage);
+        waitKey(0); // Wait for a key press to close the window
+        cout << (size == 1 ? "Result Image Displayed (Single Process)" : "Result Image Displayed") << endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    int N;
+    // Only the main thread of each rank calls MPI, the threads just filter
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    if (provided < MPI_THREAD_FUNNELED) {
+        if (rank == 0) {
+            cerr << "Error: MPI does not support MPI_THREAD_FUNNELED" << endl;
+        }
+        MPI_Finalize();
+        return -1;
+    }
+
+    // One rank per node, tiled threads inside it; strips or on-demand blocks
+    // and the thread options from the command line
+    hpf::ExecutionPolicy policy;
+    policy.backend = hpf::Backend::Hybrid;
+    policy.tiled = true;
+    if (!hpf::parseExecutionArgs(argc, argv, policy)) {
+        MPI_Finalize();
+        return -1;
+    }
+    string imagePath = "D:/Samples/cat.jpeg";
+
+    // Only rank 0 decodes the image
+    Mat imageData;
+    int loaded = 0;
+    if (rank == 0) {
+        hpf::TraceScope phase("imread", "io");
+        imageData = imread(imagePath, IMREAD_COLOR);
+        loaded = !imageData.empty();
+    }
+    MPI_Bcast(&loaded, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (!loaded) {
+        if (rank == 0) {
+            cerr << "Error: Could not open or read the image" << endl;
+        }
+        MPI_Finalize();
+        return -1;
+    }
+    double start_s;
+
+    if (rank == 0) {
+        cout << "Enter the size of the kernel (odd and greater than or equal to 3): ";
+        cin >> N;
+    }
+    start_s = MPI_Wtime();
+
+    // The kernel reaches the other ranks with the plan
+    hpf::Kernel kernel;
+    if (rank == 0) {
+        kernel = hpf::generateHighPassKernel(N);
+        cout << kernel.taps << endl;
+    }
+    parallelHighPassFilter(imageData, kernel, policy, rank, size, start_s);
+    if (!policy.tracePath.empty()) {
+        hpf::writeTrace(policy.tracePath, MPI_COMM_WORLD);
+    }
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include <cstdlib>
+#include <iostream>
+#include <mpi.h>
+#include <opencv2/core.hpp>
+
+#include "filter_engine/mapped_io.hpp"
+#include "filter_engine/streaming.hpp"
+
+using namespace std;
+
+int main(int argc, char** argv) {
+    // Threads filter each rank's strip, only the main thread calls MPI
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    // Kernel size, input and output come first, the execution options after them
+    if (argc < 4) {
+        if (rank == 0) {
+            cerr << "Usage: " << argv[0] << " <kernel size> <input.pgm|ppm> <output.pgm|ppm> [options]" << endl;
+        }
+        MPI_Finalize();
+        return -1;
+    }
+    hpf::ExecutionPolicy policy;
+    policy.backend = provided >= MPI_THREAD_FUNNELED ? hpf::Backend::Hybrid : hpf::Backend::MPI;
+    if (!hpf::parseExecutionArgs(argc - 3, argv + 3, policy)) {
+        MPI_Finalize();
+        return -1;
+    }
+
+    // Rank 0 picks how the kernel is evaluated, for every rank
+    hpf::FilterPlan plan;
+    if (rank == 0) {
+        hpf::NetpbmReader header;
+        if (header.open(argv[2])) {
+            hpf::PlanOptions options;
+            options.imageSize = header.size();
+            plan = hpf::cachedFilterPlan(hpf::generateHighPassKernel(atoi(argv[1])), options);
+            cout << "Filter strategy: " << hpf::describePlan(plan) << endl;
+        }
+    }
+    hpf::broadcastPlan(plan, 0, MPI_COMM_WORLD);
+    if (plan.kernel.empty()) {
+        MPI_Finalize();
+        return -1;
+    }
+
+    // Every rank maps its strip of both files, nothing is sent between them
+    double start = MPI_Wtime();
+    bool ok = hpf::filterMapped(argv[2], argv[3], plan, policy);
+    if (rank == 0 && ok) {
+        cout << "time: " << (MPI_Wtime() - start) * 1000 << "ms" << endl;
+    }
+    if (!policy.tracePath.empty()) {
+        hpf::writeTrace(policy.tracePath, MPI_COMM_WORLD);
+    }
+    MPI_Finalize();
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,49 @@
+#include <opencv2/core.hpp>
+#include <cstdlib>
+#include <iostream>
+#include <omp.h>
+#include <string>
+
+#include "filter_engine/streaming.hpp"
+
+using namespace std;
+
+int main(int argc, char** argv)
+{
+    // Kernel size, input and output come first, the options after them
+    if (argc < 4) {
+        cerr << "Usage: " << argv[0] << " <kernel size> <input.pgm|ppm> <output.pgm|ppm> [--band-rows N] [options]" << endl;
+        return 1;
+    }
+    hpf::ExecutionPolicy policy;
+    policy.backend = hpf::Backend::OpenMP;
+    int bandRows = 0;
+    if (!hpf::parseStreamArgs(argc - 3, argv + 3, policy, bandRows)) {
+        return 1;
+    }
+
+    hpf::Kernel kernel = hpf::generateHighPassKernel(atoi(argv[1]));
+    if (kernel.empty()) {
+        return 1;
+    }
+
+    // Only the header is read here, the rows follow band by band
+    hpf::NetpbmReader header;
+    if (!header.open(argv[2])) {
+        return 1;
+    }
+    hpf::PlanOptions options;
+    options.imageSize = header.size();
+    hpf::FilterPlan plan = hpf::cachedFilterPlan(kernel, options);
+    cout << "Filter strategy: " << hpf::describePlan(plan) << endl;
+
+    double start_time = omp_get_wtime();
+    if (!hpf::filterStream(argv[2], argv[3], plan, policy, bandRows)) {
+        return 1;
+    }
+    cout << "Elapsed time: " << (omp_get_wtime() - start_time) * 1000 << " msec" << endl;
+    if (!policy.tracePath.empty()) {
+        hpf::writeTrace(policy.tracePath, MPI_COMM_WORLD);
+    }
+    return 0;
+}
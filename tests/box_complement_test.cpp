@@ -0,0 +1,70 @@
+#include <opencv2/core.hpp>
+#include <iostream>
+
+#include "filter_engine/convolution.hpp"
+
+// Usage: box_complement_test
+// Compares the running-sum box complement with the brute-force direct loop
+// on generated high-pass kernels, from the smallest to the largest one the
+// box path accepts, and exits with 1 unless they match bit for bit.
+int main() {
+    // 181 is the largest odd size whose 2 * (size^2 - 1) * 255 stays below
+    // the float exactness limit of 2^24
+    const int sizes[] = { 3, 5, 31, 181 };
+
+    // Odd image sizes, the largest kernel spans the whole image
+    const int width = 61, height = 45;
+    const cv::Rect rois[] = {
+        cv::Rect(0, 0, width, height),                 // Whole image
+        cv::Rect(0, 0, 9, 7),                          // Top left corner
+        cv::Rect(width - 9, height - 7, 9, 7),         // Bottom right corner
+        cv::Rect(0, 11, 1, 20),                        // Left column
+        cv::Rect(width - 1, 0, 1, height),             // Right column
+        cv::Rect(5, height - 1, width - 10, 1),        // Bottom row
+        cv::Rect(17, 13, 23, 19)                       // Interior
+    };
+
+    int mismatches = 0;
+    for (int channels : { 1, 3, 4 }) {
+        cv::Mat image(height, width, CV_8UC(channels));
+        cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(256));
+        hpf::SourceBand src{ image, 0, image.rows };
+
+        for (int size : sizes) {
+            hpf::FilterPlan plan = hpf::makeFilterPlan(hpf::generateHighPassKernel(size));
+            if (plan.strategy != hpf::Strategy::BoxComplement) {
+                std::cerr << "Not a box complement: " << hpf::describePlan(plan) << std::endl;
+                ++mismatches;
+                continue;
+            }
+            for (const cv::Rect& roi : rois) {
+                cv::Mat expected, actual;
+                hpf::filterRegionDirect(src, plan.kernel, roi, expected);
+                hpf::filterRegionBoxComplement(src, plan, roi, actual);
+                if (actual.size() != expected.size() || actual.type() != expected.type() ||
+                    cv::norm(expected, actual, cv::NORM_INF) != 0) {
+                    std::cerr << "Box complement mismatch: " << size << "x" << size << ", " << channels
+                        << " channels, roi " << roi.x << "," << roi.y << " " << roi.width << "x" << roi.height
+                        << std::endl;
+                    ++mismatches;
+                }
+            }
+        }
+    }
+
+    // One size more no longer sums exactly in float and has to stay direct
+    hpf::PlanOptions options;
+    options.allowFFT = false;
+    hpf::FilterPlan tooLarge = hpf::makeFilterPlan(hpf::generateHighPassKernel(183), options);
+    if (tooLarge.strategy == hpf::Strategy::BoxComplement) {
+        std::cerr << "Box complement past the exactness limit: " << hpf::describePlan(tooLarge) << std::endl;
+        ++mismatches;
+    }
+
+    if (mismatches > 0) {
+        std::cerr << mismatches << " box complement mismatches." << std::endl;
+        return 1;
+    }
+    std::cout << "The box complement matches the direct loop." << std::endl;
+    return 0;
+}
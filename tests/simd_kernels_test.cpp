@@ -0,0 +1,17 @@
+#include <iostream>
+
+#include "filter_engine/convolution.hpp"
+
+// Usage: simd_kernels_test
+// Compares every SIMD row kernel this CPU runs with the scalar direct loops
+// and exits with 1 on any mismatch.
+int main() {
+    std::cout << "SIMD level: " << hpf::simdLevelName(hpf::detectSimdLevel()) << std::endl;
+    int mismatches = hpf::verifySimdKernels(std::cerr);
+    if (mismatches > 0) {
+        std::cerr << mismatches << " SIMD mismatches." << std::endl;
+        return 1;
+    }
+    std::cout << "All SIMD kernels match the scalar loops." << std::endl;
+    return 0;
+}